@@ -1,7 +1,15 @@
 /**
- * The module fifo_queue shows how to use three semaphores to create a multiple-producer
+ * The module fifo_queue shows how to use two semaphores and a mutex to create a multiple-producer
  * multiple-consumer FIFO queue: producer threads will block when the FIFO is full, and
  * consumer threads will block when the FIFO is empty.
+ * The _Timeout variants give up waiting, for room or an item and for the mutex, after the given number
+ * of ms, returning HAL_TIMEOUT, and the _Try variants never block, returning HAL_BUSY if the FIFO is full
+ * or empty, or if another thread is using it. As the mutex is owned by the calling thread, none of the fns
+ * can be called by ISRs.
+ * The fn FifoQueue_PutN and FifoQueue_GetN move a batch of items with a single lock acquisition
+ * and a single signal per semaphore: they block until at least one item fits or is available,
+ * then move as many as they can, up to count, and return how many they moved. With count 0, they return 0
+ * right away, without blocking.
  *
  * Example:
  * ```c
@@ -16,6 +24,11 @@
  * uint32_t item
  * item = FifoQueue_Get(&fifo);
  * item = FifoQueue_Get(&fifo);
+ *
+ * if (FifoQueue_GetTimeout(&fifo, &item, 10) == HAL_TIMEOUT)
+ * {
+ *     // no item within 10 ms
+ * }
  * ```
  */
 
@@ -33,7 +46,7 @@ typedef struct
     uint32_t *get_pt;
     Semaphore_t current_size;
     Semaphore_t room_left;
-    Semaphore_t mutex;
+    Mutex_t mutex;
 } FifoQueue_t;
 
 void FifoQueue_Init(FifoQueue_t *fifo);
@@ -41,3 +54,15 @@ void FifoQueue_Init(FifoQueue_t *fifo);
 void FifoQueue_Put(FifoQueue_t *fifo, uint32_t item);
 
 uint32_t FifoQueue_Get(FifoQueue_t *fifo);
+
+HAL_StatusTypeDef FifoQueue_PutTimeout(FifoQueue_t *fifo, uint32_t item, uint32_t timeout_ms);
+
+HAL_StatusTypeDef FifoQueue_GetTimeout(FifoQueue_t *fifo, uint32_t *item, uint32_t timeout_ms);
+
+HAL_StatusTypeDef FifoQueue_TryPut(FifoQueue_t *fifo, uint32_t item);
+
+HAL_StatusTypeDef FifoQueue_TryGet(FifoQueue_t *fifo, uint32_t *item);
+
+uint32_t FifoQueue_PutN(FifoQueue_t *fifo, const uint32_t *items, uint32_t count);
+
+uint32_t FifoQueue_GetN(FifoQueue_t *fifo, uint32_t *items, uint32_t count);
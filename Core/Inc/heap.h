@@ -0,0 +1,44 @@
+/**
+ * The module heap replaces newlib's sbrk-based allocator with a two-level segregated fit (TLSF)
+ * allocator, whose malloc and free take bounded, constant time regardless of the heap's state.
+ *
+ * The heap spans the region between the symbols _sheap and _eheap, defined in the linker script,
+ * and is set up on the first allocation. Free blocks are kept in one list per size class: the
+ * first level splits sizes in powers of two, the second level splits each power of two in
+ * 16 linear ranges, and two bitmaps, resolved with CLZ, find a non-empty list in O(1).
+ * Freed blocks are merged with their free neighbours right away.
+ *
+ * The module implements newlib's reentrant allocation fns (_malloc_r, _free_r, _calloc_r and _realloc_r),
+ * so malloc, free, printf, new, etc. all go through it. Each of them takes the newlib malloc lock,
+ * __malloc_lock, which is implemented on top of a kernel mutex once the OS is running.
+ * The heap must not be used by ISRs.
+ *
+ * Example:
+ * ```c
+ * #include "heap.h"
+ *
+ * uint8_t *buffer = malloc(100);
+ * free(buffer);
+ *
+ * HeapStats_t stats;
+ * Heap_GetStats(&stats);
+ * ```
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t total_bytes;           /* Bytes managed by the heap, block headers included */
+    uint32_t free_bytes;            /* Bytes in the free blocks, block headers included */
+    uint32_t largest_free_block;    /* Size of the largest block that can be allocated */
+    uint32_t peak_used_bytes;       /* Maximum bytes in the used blocks at the same time (high-water mark) */
+    uint32_t fragmentation_percent; /* Free bytes outside the largest free block, in percent of the free bytes */
+} HeapStats_t;
+
+/**
+ * The fn Heap_GetStats reports the heap's usage and fragmentation, to size the heap from field data.
+ */
+void Heap_GetStats(HeapStats_t *stats);
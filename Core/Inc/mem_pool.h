@@ -0,0 +1,61 @@
+/**
+ * The module mem_pool provides pools of fixed-size memory blocks, carved out of a static array
+ * provided by the caller and sized with the macro MEMPOOL_STORAGE_WORDS.
+ * Free blocks are linked through their first word, so allocating and freeing take constant time.
+ *
+ * The fn MemPool_Alloc blocks the calling thread until a block is available, and MemPool_AllocTimeout
+ * gives up after timeout_ms, returning HAL_TIMEOUT. The fn MemPool_TryAlloc never blocks, returning
+ * HAL_BUSY if the pool is empty, and like MemPool_Free can be called by ISRs too.
+ * The fn MemPool_GetStats reports the blocks in use and the peak since init, for sizing the pools.
+ *
+ * Example:
+ * ```c
+ * #include "mem_pool.h"
+ *
+ * static uint32_t FramesStorage[MEMPOOL_STORAGE_WORDS(sizeof(Frame_t), 8)];
+ * static MemPool_t Frames;
+ * MemPool_Init(&Frames, FramesStorage, sizeof(Frame_t), 8);
+ *
+ * Frame_t *frame = MemPool_Alloc(&Frames);
+ * MemPool_Free(&Frames, frame);
+ * ```
+ */
+
+#pragma once
+
+#include "os.h"
+#include <stdint.h>
+
+/* Each block is rounded up to whole words, and holds at least the free list's link */
+#define MEMPOOL_BLOCK_WORDS(block_size) (((block_size) + 3) / 4 > 0 ? ((block_size) + 3) / 4 : 1)
+#define MEMPOOL_STORAGE_WORDS(block_size, num_blocks) (MEMPOOL_BLOCK_WORDS(block_size) * (num_blocks))
+
+typedef struct
+{
+    uint32_t used_count;      /* Blocks currently allocated */
+    uint32_t peak_used_count; /* Maximum number of blocks allocated at the same time */
+    uint32_t num_blocks;      /* Blocks in the pool */
+} MemPoolStats_t;
+
+typedef struct
+{
+    void *free_list;
+    uint32_t *storage;
+    uint32_t block_words;
+    uint32_t num_blocks;
+    uint32_t used_count;
+    uint32_t peak_used_count;
+    Semaphore_t free_blocks;
+} MemPool_t;
+
+void MemPool_Init(MemPool_t *pool, uint32_t *storage, uint32_t block_size, uint32_t num_blocks);
+
+void *MemPool_Alloc(MemPool_t *pool);
+
+HAL_StatusTypeDef MemPool_AllocTimeout(MemPool_t *pool, void **block, uint32_t timeout_ms);
+
+HAL_StatusTypeDef MemPool_TryAlloc(MemPool_t *pool, void **block);
+
+void MemPool_Free(MemPool_t *pool, void *block);
+
+void MemPool_GetStats(MemPool_t *pool, MemPoolStats_t *stats);
@@ -0,0 +1,70 @@
+/**
+ * The module msg_queue provides multiple-producer multiple-consumer queues of variable-size messages,
+ * stored in place, so that payloads don't need to be copied in and out of the queue.
+ * Each queue has its own number of slots and maximum message size, and its storage is provided
+ * by the caller, sized with the macro MSGQUEUE_STORAGE_WORDS.
+ *
+ * A producer reserves a slot, writes the message straight into it, then commits it with the
+ * message's length; a consumer receives the oldest message, reads it in place, then releases it.
+ * Producer threads will block when the queue is full, and consumer threads will block when the queue is empty.
+ * The queue's put side is locked from reserve to commit, and its get side from receive to release,
+ * so the slot must be committed/released by the same thread, and without waiting on the same queue in between.
+ * The _Timeout variants give up after the given number of ms, whether they're waiting for a slot or for
+ * the side of the queue to be unlocked, returning HAL_TIMEOUT.
+ *
+ * Example:
+ * ```c
+ * #include "msg_queue.h"
+ *
+ * static uint32_t FramesStorage[MSGQUEUE_STORAGE_WORDS(512, 4)];
+ * static MsgQueue_t Frames;
+ * MsgQueue_Init(&Frames, FramesStorage, 512, 4);
+ *
+ * uint8_t *frame = MsgQueue_Reserve(&Frames);
+ * uint32_t frame_length = Sensor_ReadFrame(frame, 512);
+ * MsgQueue_Commit(&Frames, frame_length);
+ *
+ * uint32_t length;
+ * const uint8_t *received = MsgQueue_Receive(&Frames, &length);
+ * Process(received, length);
+ * MsgQueue_Release(&Frames);
+ * ```
+ */
+
+#pragma once
+
+#include "os.h"
+#include <stdint.h>
+
+/* Each slot holds the message's length, followed by the payload rounded up to whole words */
+#define MSGQUEUE_SLOT_WORDS(max_msg_size) (1 + ((max_msg_size) + 3) / 4)
+#define MSGQUEUE_STORAGE_WORDS(max_msg_size, num_slots) (MSGQUEUE_SLOT_WORDS(max_msg_size) * (num_slots))
+
+typedef struct
+{
+    uint32_t *storage;
+    uint32_t max_msg_size;
+    uint32_t slot_words;
+    uint32_t num_slots;
+    uint32_t put_idx;
+    uint32_t get_idx;
+    Semaphore_t slots_used;
+    Semaphore_t slots_free;
+    Mutex_t put_mutex;
+    Mutex_t get_mutex;
+} MsgQueue_t;
+
+void MsgQueue_Init(MsgQueue_t *queue, uint32_t *storage, uint32_t max_msg_size, uint32_t num_slots);
+
+void *MsgQueue_Reserve(MsgQueue_t *queue);
+
+HAL_StatusTypeDef MsgQueue_ReserveTimeout(MsgQueue_t *queue, void **payload, uint32_t timeout_ms);
+
+void MsgQueue_Commit(MsgQueue_t *queue, uint32_t msg_size);
+
+const void *MsgQueue_Receive(MsgQueue_t *queue, uint32_t *msg_size);
+
+HAL_StatusTypeDef MsgQueue_ReceiveTimeout(MsgQueue_t *queue, const void **payload, uint32_t *msg_size,
+                                          uint32_t timeout_ms);
+
+void MsgQueue_Release(MsgQueue_t *queue);
@@ -1,14 +1,14 @@
 /**
- * The module onboard_user_button shows how to use the semaphore provided by the OS
+ * The module onboard_user_button shows how to use the thread notifications provided by the OS
  * to debounce the onboard user button on PA0.
  *
  * In short:
  * - the interrupt handler is registered on rising edges of PA0;
- * - the OnboardUserButton_Task is run by the OS, but blocks immediately waiting for SemaphoreButtonPressed;
- * - when the interrupt is triggered, SemaphoreButtonPressed is signaled;
- * - the task unblocks on SemaphoreButtonPressed, invokes the callback function, and debounces the button;
+ * - the OnboardUserButton_Task is run by the OS, enables the interrupt, and blocks waiting for a notification;
+ * - when the interrupt is triggered, the handler notifies the task through its handle;
+ * - the task unblocks, invokes the callback function, and debounces the button;
  * - the callback function toggles the onboard LED on PE8;
- * - the task blocks again on SemaphoreButtonPressed;
+ * - the task blocks again waiting for the next notification;
  *
  * How this module is used in the project:
  *
@@ -42,10 +42,10 @@
  * }
  * ```
  *
- * IMPORTANT!
- * For this module to behave properly, make sure THREADFREQ is at least 500Hz.
- * Conversely, if THREADFREQ is 1Hz, for example, OnboardUserButton_Task might as well run
- * four seconds after the button has been pressed, making the callback fn very unresponsive.
+ * As OnboardUserButton_Task has a higher priority than the main threads, notifying it
+ * preempts the running thread, and the task runs right after the interrupt handler returns,
+ * regardless of THREADFREQ. The latency can be measured with the logic analyzer, between the
+ * rising edge on PA0 and the toggle of PE8.
  */
 
 #pragma once
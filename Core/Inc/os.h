@@ -5,23 +5,190 @@
 
 #pragma once
 
-#include <stdint.h>
-
 #define MAXNUMTHREADS 10 /* Maximum number of threads, allocated at compile time */
-#define STACKSIZE 100    /* Number of 32-bit words in each TCB's stack */
+#define STACKSIZE 100    /* Default number of 32-bit words in a thread's stack */
 #define THREADFREQ 1     /* Maximum time-slice, in Hz, before the scheduler is run */
 
+#define OS_STACKSIZE_MIN 64    /* Minimum number of 32-bit words in a thread's stack, enough for an FP context switch */
+#define OS_IDLE_STACKSIZE 100  /* Number of 32-bit words in the idle thread's stack, which runs the idle hooks */
+#define OS_STACKPOOL_SIZE 1280 /* Number of 32-bit words in the pool OS_Thread_Create carves stacks out of */
+
+#define OS_STACK_PAINT 0xC5C5C5C5 /* Pattern the stacks are filled with at creation, to measure their usage */
+
+/* Stack overflow detection, one of:
+ *   - OS_STACK_OVERFLOW_CHECK_NONE;
+ *   - OS_STACK_OVERFLOW_CHECK_CANARY: on every context switch, the lowest word of the stack switched out is checked;
+ *   - OS_STACK_OVERFLOW_CHECK_MPU: an MPU region traps any access to the lowest 32 bytes of the running thread's
+ *     stack, as soon as it happens. Stacks are then 32-byte aligned, and their sizes rounded up to 8 words */
+#define OS_STACK_OVERFLOW_CHECK_NONE 0
+#define OS_STACK_OVERFLOW_CHECK_CANARY 1
+#define OS_STACK_OVERFLOW_CHECK_MPU 2
+#define OS_STACK_OVERFLOW_CHECK OS_STACK_OVERFLOW_CHECK_MPU
+
+/* Place the thread stacks, the TCBs and the scheduler's data and code in the 8K of CCM RAM (1) or not (0).
+ * The CCM RAM is tightly coupled to the core, so context switches don't contend the bus matrix with the DMA.
+ * However, the DMA can't access it: buffers on a thread's stack can't be used for DMA transfers */
+#define OS_USE_CCMRAM 0
+
+#define OS_TICKLESS_IDLE 1        /* Suppress the periodic tick while no thread is ready (1) or not (0) */
+#define OS_TICKLESS_MIN_IDLE_MS 2 /* Minimum idle time, in ms, for the periodic tick to be suppressed */
+
+#define OS_MAXNUMIDLEHOOKS 4     /* Maximum number of fns run by the idle thread */
+#define OS_CPULOAD_PERIOD_MS 100 /* Duration of each period in the CPU load's sliding window */
+#define OS_CPULOAD_WINDOW 10     /* Number of periods in the CPU load's sliding window */
+
+/* Kernel critical sections raise BASEPRI to mask the interrupts with a preemption priority numerically
+ * >= OS_KERNEL_IRQ_PRIORITY (the kernel ceiling), leaving the others enabled. ISRs above the ceiling, such as
+ * motor control loops, are never delayed by the kernel, but must not call any kernel fn.
+ * The SysTick and the SchedlTimer must be at or below the ceiling */
+#define OS_KERNEL_IRQ_PRIORITY 5
+#define OS_KERNEL_BASEPRI (OS_KERNEL_IRQ_PRIORITY << 4) /* BASEPRI value, the STM32F3 implements 4 priority bits */
+
 #define OS_SCHEDL_PRIO_MIN UINT8_MAX    /* Lowest priority that can be assigned to a thread */
 #define OS_SCHEDL_PRIO_MAX 0            /* Highest priority that can be assigned to a thread */
 #define OS_SCHEDL_PRIO_MAIN_THREAD 200  /* Baseline priority to be assigned to main threads */
 #define OS_SCHEDL_PRIO_EVENT_THREAD 100 /* Baseline priority to be assigned to event threads */
 
+/* The defines above are shared with os_asm.s, what follows is C only */
+#ifndef __ASSEMBLER__
+
+#include "stm32f3xx_hal.h"
+#include "timing_wheel.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#if OS_USE_CCMRAM
+#define OS_THREAD_STACKS_SECTION ".ccmbss.thread_stacks"
+#else
+#define OS_THREAD_STACKS_SECTION ".thread_stacks"
+#endif
+
+/* The MPU guard region at the bottom of each stack must be aligned to its size,
+ * otherwise stacks are 8-byte aligned, as required by the AAPCS on exception entry */
+#if OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_MPU
+#define OS_STACK_ALIGN 32
+#else
+#define OS_STACK_ALIGN 8
+#endif
+
+/**
+ * The macro OS_THREAD_STACK declares a stack of size 32-bit words for OS_Thread_CreateWithStack,
+ * placed in the linker's thread stacks region (or in CCM RAM, see OS_USE_CCMRAM), so that the map file
+ * reports it with the other stacks.
+ *
+ * Example:
+ * ```c
+ * OS_THREAD_STACK(ParserStack, 512);
+ * OS_Thread_CreateWithStack(ParserTask, OS_SCHEDL_PRIO_MAIN_THREAD, "ParserTask", ParserStack, 512);
+ * ```
+ */
+#define OS_THREAD_STACK(name, size)                                                                                    \
+    static uint32_t name[(size)] __attribute__((section(OS_THREAD_STACKS_SECTION), aligned(OS_STACK_ALIGN)));          \
+    _Static_assert((size) % (OS_STACK_ALIGN / 4) == 0 && (size) >= OS_STACKSIZE_MIN,                                   \
+                   "stack size must be a multiple of OS_STACK_ALIGN bytes and >= OS_STACKSIZE_MIN")
+
+/**
+ * The fn OS_Critical_Enter raises BASEPRI to the kernel ceiling, masking the interrupts that may call kernel fns,
+ * and the fn OS_Critical_Exit unmasks them again. Critical sections don't nest.
+ *
+ * On the Cortex-M4 r0p1, which the STM32F3 is based on, an interrupt might still be taken right after
+ * BASEPRI is raised (ARM erratum 837070), so the write is wrapped in CPSID and CPSIE.
+ */
+static inline void OS_Critical_Enter(void)
+{
+    __disable_irq();
+    __set_BASEPRI(OS_KERNEL_BASEPRI);
+    __DSB();
+    __ISB();
+    __enable_irq();
+}
+
+static inline void OS_Critical_Exit(void)
+{
+    __set_BASEPRI(0);
+}
+
+/**
+ * The TCB is private to os.c, kernel objects only hold pointers to it.
+ * The type ThreadHandle_t identifies a thread, for the fns that act on a thread other than the calling one.
+ */
+struct TCB;
+typedef struct TCB *ThreadHandle_t;
+
+/**
+ * The type NotifyAction_t tells how OS_Thread_Notify updates the thread's notification value.
+ */
+typedef enum
+{
+    NotifyActionNone,      /* The value is left untouched, the thread is only woken up */
+    NotifyActionSetBits,   /* The value is or-ed with the given bits, like event flags */
+    NotifyActionIncrement, /* The value is incremented, like a counting semaphore */
+    NotifyActionOverwrite  /* The value is overwritten, like a mailbox holding the last item */
+} NotifyAction_t;
+
+/**
+ * The type Semaphore_t abstracts the semaphore's counter and the list of threads blocked on it.
+ * A value of type *Semaphore_t should be initialized with the fn OS_Semaphore_Init, and only
+ * updated through the fn OS_Semaphore_Wait (or its timed and non-blocking variants) and OS_Semaphore_Signal.
+ */
+typedef struct
+{
+    int32_t counter;     /* When negative, the number of threads blocked. Updated with LDREX/STREX on the fast path */
+    struct TCB *waiters; /* Threads blocked, ordered by priority, then by arrival */
+} Semaphore_t;
+
+/**
+ * The type Mutex_t abstracts a lock owned by the thread that took it.
+ * The owner can lock it recursively, and inherits the priority of the threads blocked on it,
+ * so that a high priority thread can't be starved by medium priority ones while a low priority
+ * thread holds the lock (priority inversion).
+ * A value of type *Mutex_t should be initialized with the fn OS_Mutex_Init, and only
+ * updated through the fn OS_Mutex_Lock (or its timed and non-blocking variants) and OS_Mutex_Unlock.
+ */
+typedef struct Mutex
+{
+    struct TCB *owner;       /* Thread holding the mutex, NULL if free */
+    uint32_t lock_count;     /* Number of times the owner locked the mutex */
+    struct TCB *waiters;     /* Threads blocked, ordered by priority, then by arrival */
+    struct Mutex *next_held; /* Next mutex held by the same owner */
+} Mutex_t;
+
+/**
+ * The type EventFlags_t abstracts a group of 32 flags, set by threads or ISRs, on which threads can
+ * wait until any or all of the flags they're interested in are set.
+ * A value of type *EventFlags_t should be initialized with the fn OS_EventFlags_Init, and only
+ * updated through the fns OS_EventFlags_Set, OS_EventFlags_Clear and OS_EventFlags_Wait (or its timed
+ * and non-blocking variants).
+ */
+typedef struct
+{
+    uint32_t flags;        /* Flags currently set */
+    uint32_t waited_flags; /* Superset of the flags the blocked threads wait for, refreshed by OS_EventFlags_Set */
+    struct TCB *waiters;   /* Threads blocked, ordered by priority, then by arrival */
+} EventFlags_t;
+
+/* Options for OS_EventFlags_Wait, OS_EVENTFLAGS_WAIT_ANY or OS_EVENTFLAGS_WAIT_ALL,
+ * possibly or-ed with OS_EVENTFLAGS_CLEAR_ON_EXIT */
+#define OS_EVENTFLAGS_WAIT_ANY 0x0      /* Wait until any of the flags is set */
+#define OS_EVENTFLAGS_WAIT_ALL 0x1      /* Wait until all the flags are set */
+#define OS_EVENTFLAGS_CLEAR_ON_EXIT 0x2 /* Clear the flags waited for once the wait is satisfied */
+
 /**
- * The type Semaphore_t abstracts the semaphore's counter.
- * A value of type *Semaphore_t should only be updated through the fn OS_Semaphore_Wait
- * and OS_Semaphore_Signal.
+ * The type Timeout_t is an entry of the kernel's timing wheel.
+ * A value of type *Timeout_t should be initialized with the fn OS_Timeout_Init, and only
+ * updated through the fns OS_Timeout_Start and OS_Timeout_Cancel.
  */
-typedef int32_t Semaphore_t;
+typedef TimingWheelEntry_t Timeout_t;
+
+/**
+ * The type StackUsage_t reports how much of a thread's stack has been used, see OS_Stack_GetUsage.
+ */
+typedef struct
+{
+    const char *name;    /* Name given to the thread at creation */
+    uint32_t stack_size; /* Number of 32-bit words in the thread's stack */
+    uint32_t stack_used; /* Maximum number of words used since the thread was created (high-water mark) */
+} StackUsage_t;
 
 /**
  * Function descriptions are provided in os.c
@@ -29,22 +196,93 @@ typedef int32_t Semaphore_t;
 
 void OS_Init(uint32_t scheduler_frequency_hz);
 
-void OS_Thread_CreateFirst(void (*task)(void), uint8_t priority, const char *name);
+ThreadHandle_t OS_Thread_CreateFirst(void (*task)(void), uint8_t priority, const char *name, uint32_t stack_size);
+
+ThreadHandle_t OS_Thread_Create(void (*task)(void), uint8_t priority, const char *name, uint32_t stack_size);
+
+ThreadHandle_t OS_Thread_CreateWithStack(void (*task)(void), uint8_t priority, const char *name, uint32_t *stack,
+                                         uint32_t stack_size);
 
-void OS_Thread_Create(void (*task)(void), uint8_t priority, const char *name);
+ThreadHandle_t OS_Thread_GetCurrent(void);
 
 void OS_Launch(void);
 
+bool OS_IsRunning(void);
+
+void OS_Scheduler_Invoke(void);
+
 void OS_Scheduler(void);
 
 void OS_Thread_Suspend(void);
 
 void OS_Thread_Sleep(uint32_t sleep_duration_ms);
 
-void OS_DecrementTCBsSleepDuration(void);
+void OS_Tick(void);
 
 void OS_Thread_Kill(void);
 
+void OS_Thread_Notify(ThreadHandle_t thread, NotifyAction_t action, uint32_t value);
+
+void OS_Thread_NotifyGive(ThreadHandle_t thread);
+
+uint32_t OS_Thread_NotifyWait(uint32_t clear_on_exit);
+
+HAL_StatusTypeDef OS_Thread_NotifyWaitTimeout(uint32_t clear_on_exit, uint32_t *value, uint32_t timeout_ms);
+
+void OS_Timeout_Init(Timeout_t *timeout, void (*callback)(void *arg), void *arg);
+
+void OS_Timeout_Start(Timeout_t *timeout, uint32_t timeout_ms);
+
+void OS_Timeout_Cancel(Timeout_t *timeout);
+
+bool OS_Timeout_IsActive(Timeout_t *timeout);
+
+void OS_Idle_AddHook(void (*hook)(void));
+
+uint32_t OS_CPULoad_Get(void);
+
+uint32_t OS_Stack_GetUsage(StackUsage_t *usages, uint32_t max_count);
+
+void OS_Stack_RecordOverflow(void);
+
+void OS_Mutex_Init(Mutex_t *mutex);
+
+void OS_Mutex_Lock(Mutex_t *mutex);
+
+void OS_Mutex_Unlock(Mutex_t *mutex);
+
+HAL_StatusTypeDef OS_Mutex_LockTimeout(Mutex_t *mutex, uint32_t timeout_ms);
+
+HAL_StatusTypeDef OS_Mutex_TryLock(Mutex_t *mutex);
+
+void OS_Semaphore_Init(Semaphore_t *sem, int32_t initial_counter);
+
 void OS_Semaphore_Wait(Semaphore_t *sem);
 
+HAL_StatusTypeDef OS_Semaphore_WaitTimeout(Semaphore_t *sem, uint32_t timeout_ms);
+
+HAL_StatusTypeDef OS_Semaphore_TryWait(Semaphore_t *sem);
+
 void OS_Semaphore_Signal(Semaphore_t *sem);
+
+uint32_t OS_Semaphore_WaitUpTo(Semaphore_t *sem, uint32_t max_count);
+
+void OS_Semaphore_SignalN(Semaphore_t *sem, uint32_t count);
+
+void OS_EventFlags_Init(EventFlags_t *event_flags);
+
+void OS_EventFlags_Set(EventFlags_t *event_flags, uint32_t flags);
+
+void OS_EventFlags_Clear(EventFlags_t *event_flags, uint32_t flags);
+
+uint32_t OS_EventFlags_Get(EventFlags_t *event_flags);
+
+uint32_t OS_EventFlags_Wait(EventFlags_t *event_flags, uint32_t flags, uint32_t options);
+
+HAL_StatusTypeDef OS_EventFlags_WaitTimeout(EventFlags_t *event_flags, uint32_t flags, uint32_t options,
+                                            uint32_t *matched_flags, uint32_t timeout_ms);
+
+HAL_StatusTypeDef OS_EventFlags_TryWait(EventFlags_t *event_flags, uint32_t flags, uint32_t options,
+                                        uint32_t *matched_flags);
+
+#endif /* __ASSEMBLER__ */
@@ -17,9 +17,9 @@ void SchedlTimer_Init(uint32_t reload_frequency_hz);
 
 void SchedlTimer_Start(void);
 
-void SchedlTimer_ClearITFlag(void);
+void SchedlTimer_Stop(void);
 
-void SchedlTimer_ResetCounter(void);
+void SchedlTimer_ClearITFlag(void);
 
-/* Implemented in os_asm.s */
+/* Implemented in stm32f3xx_it.c */
 void SchedlTimer_IRQHandler(void);
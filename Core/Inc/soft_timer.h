@@ -0,0 +1,75 @@
+/**
+ * The module soft_timer provides one-shot and auto-reload software timers, all managed by a single
+ * daemon thread, so that periodic jobs can share the daemon's stack instead of running a thread each.
+ *
+ * The daemon keeps the armed timers in a list ordered by expiry time, sleeps until the first one
+ * expires, and runs the callbacks in its own context: callbacks must not block, and their duration
+ * delays the timers expiring after them. Auto-reload timers are re-armed relative to their previous
+ * expiry, so they don't drift.
+ *
+ * The fns SoftTimer_Start, SoftTimer_Stop and SoftTimer_Reset don't touch the list: they post a command
+ * to the daemon and notify it, so they never block and can be called by ISRs too. They return HAL_BUSY
+ * if the command queue is full. The commands record the tick they were issued at, so the expiry doesn't
+ * depend on when the daemon processes them.
+ *
+ * Example:
+ * ```c
+ * #include "soft_timer.h"
+ *
+ * static SoftTimer_t BlinkTimer;
+ *
+ * static void Blink(void *arg)
+ * {
+ *     InstrumentTriggerPE9_Toggle();
+ * }
+ *
+ * int main(void)
+ * {
+ *     // ...
+ *     OS_Thread_Create(SoftTimer_DaemonTask, OS_SCHEDL_PRIO_EVENT_THREAD, "SoftTimer_DaemonTask", STACKSIZE);
+ *     SoftTimer_Init(&BlinkTimer, Blink, NULL, 500, SoftTimerModeAutoReload);
+ *     IFERR_PANIC(SoftTimer_Start(&BlinkTimer));
+ *     OS_Launch();
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "os.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SOFTTIMER_QUEUE_SIZE 16 /* Maximum number of commands waiting to be processed by the daemon */
+
+typedef enum
+{
+    SoftTimerModeOneShot,   /* The timer expires once, then it's stopped */
+    SoftTimerModeAutoReload /* The timer is re-armed every time it expires */
+} SoftTimerMode_t;
+
+/**
+ * A value of type *SoftTimer_t should be initialized with the fn SoftTimer_Init, then only updated
+ * through the fns SoftTimer_Start, SoftTimer_Stop and SoftTimer_Reset.
+ */
+typedef struct SoftTimer
+{
+    void (*callback)(void *arg); /* Run by the daemon thread when the timer expires */
+    void *arg;                   /* Passed to the callback */
+    uint32_t period_ms;          /* Time between the timer being started and expiring, and between expiries */
+    SoftTimerMode_t mode;        /* One-shot or auto-reload */
+    uint32_t expiry_tick;        /* HAL tick at which the timer expires, valid while active */
+    bool is_active;              /* Set while the timer is in the daemon's list */
+    struct SoftTimer *next;      /* Next timer in the daemon's list, NULL if last */
+} SoftTimer_t;
+
+void SoftTimer_Init(SoftTimer_t *timer, void (*callback)(void *arg), void *arg, uint32_t period_ms,
+                    SoftTimerMode_t mode);
+
+HAL_StatusTypeDef SoftTimer_Start(SoftTimer_t *timer);
+
+HAL_StatusTypeDef SoftTimer_Stop(SoftTimer_t *timer);
+
+HAL_StatusTypeDef SoftTimer_Reset(SoftTimer_t *timer);
+
+void SoftTimer_DaemonTask(void);
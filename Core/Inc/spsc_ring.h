@@ -0,0 +1,99 @@
+/**
+ * The module spsc_ring provides a macro that generates a lock-free single-producer single-consumer
+ * ring buffer, with its element type and capacity fixed at compile time.
+ * Unlike the FifoQueue, it never blocks and never disables interrupts, so an ISR can put items
+ * that a thread gets later on (or vice versa), as long as there's only one producer and one consumer.
+ *
+ * The capacity must be a power of two. The head and tail indices are free-running, the producer
+ * only writes the head and the consumer only writes the tail, and a DMB orders the access to the
+ * item with respect to the index that publishes it.
+ *
+ * The optional wake hook is called by the producer when the item it put is the only one in the
+ * ring once it's published, e.g. to signal a semaphore the consumer thread is blocked on. Pass NULL if not needed.
+ * The hook can be called while the consumer is still getting items, e.g. if it emptied the ring just before
+ * the producer published, so the consumer must tolerate being woken up with nothing to get.
+ *
+ * Example:
+ * ```c
+ * #include "spsc_ring.h"
+ *
+ * static Semaphore_t SampleReady;
+ * static void WakeConsumer(void)
+ * {
+ *     OS_Semaphore_Signal(&SampleReady);
+ * }
+ * SpscRing_Create(AdcSamples, uint16_t, 64, WakeConsumer);
+ *
+ * void ADC1_2_IRQHandler(void)
+ * {
+ *     (void)SpscRingAdcSamples_Put(ADC1->DR); // drop the sample if full
+ * }
+ *
+ * void ConsumerThread(void)
+ * {
+ *     uint16_t sample;
+ *     while (1)
+ *     {
+ *         OS_Semaphore_Wait(&SampleReady);
+ *         while (SpscRingAdcSamples_Get(&sample))
+ *         {
+ *             // process sample
+ *         }
+ *     }
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include "stm32f3xx_hal.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SpscRing_Create(NAME, TYPE, CAPACITY, WAKE_HOOK)                                                               \
+    static TYPE SpscRing##NAME##_Items[(CAPACITY)];                                                                    \
+    static volatile uint32_t SpscRing##NAME##_Head; /* Written by the producer only */                                 \
+    static volatile uint32_t SpscRing##NAME##_Tail; /* Written by the consumer only */                                 \
+    bool SpscRing##NAME##_Put(TYPE item)                                                                               \
+    {                                                                                                                  \
+        uint32_t head = SpscRing##NAME##_Head;                                                                         \
+        uint32_t tail = SpscRing##NAME##_Tail;                                                                         \
+        if ((head - tail) == (CAPACITY))                                                                               \
+        {                                                                                                              \
+            return false;                                                                                              \
+        }                                                                                                              \
+        SpscRing##NAME##_Items[head & ((CAPACITY)-1U)] = item;                                                         \
+        /* The item must be written before the consumer can see the new head */                                        \
+        __DMB();                                                                                                       \
+        SpscRing##NAME##_Head = head + 1U;                                                                             \
+        void (*wake_hook)(void) = (WAKE_HOOK);                                                                         \
+        /* The tail read before the item was put may be stale: read it again once the head is published,               \
+         * so that the consumer isn't left waiting if it emptied the ring meanwhile */                                 \
+        __DMB();                                                                                                       \
+        if ((wake_hook != NULL) && (SpscRing##NAME##_Tail == head))                                                    \
+        {                                                                                                              \
+            wake_hook();                                                                                               \
+        }                                                                                                              \
+        return true;                                                                                                   \
+    }                                                                                                                  \
+    bool SpscRing##NAME##_Get(TYPE *item)                                                                              \
+    {                                                                                                                  \
+        uint32_t tail = SpscRing##NAME##_Tail;                                                                         \
+        if (SpscRing##NAME##_Head == tail)                                                                             \
+        {                                                                                                              \
+            return false;                                                                                              \
+        }                                                                                                              \
+        /* The head must be read before the item it publishes */                                                       \
+        __DMB();                                                                                                       \
+        *item = SpscRing##NAME##_Items[tail & ((CAPACITY)-1U)];                                                        \
+        /* The item must be read before the producer can overwrite it */                                               \
+        __DMB();                                                                                                       \
+        SpscRing##NAME##_Tail = tail + 1U;                                                                             \
+        return true;                                                                                                   \
+    }                                                                                                                  \
+    uint32_t SpscRing##NAME##_Count(void)                                                                              \
+    {                                                                                                                  \
+        return SpscRing##NAME##_Head - SpscRing##NAME##_Tail;                                                          \
+    }                                                                                                                  \
+    _Static_assert(((CAPACITY) > 0) && (((CAPACITY) & ((CAPACITY)-1U)) == 0), "capacity must be a power of two")
@@ -133,7 +133,7 @@
 //==================================================================================================
 
 #define VDD_VALUE ((uint32_t)3300)      /*!< Value of VDD in mv */
-#define TICK_INT_PRIORITY ((uint32_t)0) /*!< tick interrupt priority (lowest by default)  */
+#define TICK_INT_PRIORITY ((uint32_t)5) /*!< tick interrupt priority, at the kernel ceiling (OS_KERNEL_IRQ_PRIORITY) */
 #define USE_RTOS 0
 #define PREFETCH_ENABLE 1
 #define INSTRUCTION_CACHE_ENABLE 0
@@ -46,7 +46,8 @@ void SVC_Handler(void);
 void DebugMon_Handler(void);
 
 /**
- * The function PendSV_Handler handles pendable requests for system service.
+ * The function PendSV_Handler handles pendable requests for system service, that is, the context switch.
+ * The implementation is in os_asm.s
  */
 void PendSV_Handler(void);
 
@@ -62,8 +63,8 @@ void SysTick_Handler(void);
 //==================================================================================================
 
 /**
- * The function SchedlTimer_IRQHandler handles SchedlTimer interrupts.
- * The implementation is in os_asm.s
+ * The function SchedlTimer_IRQHandler handles SchedlTimer interrupts, requesting a context switch
+ * when the time-slice expires.
  */
 void SchedlTimer_IRQHandler(void);
 
@@ -71,3 +72,13 @@ void SchedlTimer_IRQHandler(void);
  * The function EXTI0_IRQHandler handles EXTI interrupts from Line 0.
  */
 void EXTI0_IRQHandler(void);
+
+/**
+ * The function EXTI1_IRQHandler handles EXTI interrupts from Line 1, pended by software by UserTask_WakeupBenchmark.
+ */
+void EXTI1_IRQHandler(void);
+
+/**
+ * The function TIM7_IRQHandler handles TIM7 update interrupts, enabled by UserTask_InterruptLatencyBenchmark.
+ */
+void TIM7_IRQHandler(void);
@@ -0,0 +1,41 @@
+/**
+ * The module tick_timer abstracts the SysTick functionality used by the OS in tickless idle mode.
+ *
+ * The SysTick is set up by the HAL and interrupts every ms. When no thread is ready, the OS
+ * suppresses the periodic tick and reprograms the SysTick as a one-shot timer, which expires when
+ * the first sleeping thread has to be woken up. On wake-up, the SysTick is restored to periodic
+ * mode and HAL's tick count is corrected with the ticks that elapsed in the meantime.
+ *
+ * Example:
+ * ```c
+ * __disable_irq();
+ * if (TickTimer_Suppress(sleep_duration_ms))
+ * {
+ *     __WFI();
+ *     uint32_t elapsed_ms = TickTimer_Resume();
+ * }
+ * __enable_irq();
+ * ```
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The fn TickTimer_Suppress stops the periodic tick and programs the SysTick to interrupt once,
+ * after idle_ticks ticks (capped to the longest interval the 24-bit counter can measure).
+ * It returns false, and leaves the SysTick untouched, if a tick interrupt is already pending.
+ * It must be called with interrupts disabled.
+ */
+bool TickTimer_Suppress(uint32_t idle_ticks);
+
+/**
+ * The fn TickTimer_Resume restores the periodic tick, aligned to the tick boundaries before
+ * the suppression, and returns the number of complete ticks elapsed since TickTimer_Suppress
+ * was called. HAL's tick count is incremented by the same amount.
+ * If the one-shot timer expired, the SysTick interrupt is left pending, and accounts for the last tick.
+ * It must be called with interrupts disabled.
+ */
+uint32_t TickTimer_Resume(void);
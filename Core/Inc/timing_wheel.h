@@ -0,0 +1,101 @@
+/**
+ * The module timing_wheel keeps large numbers of pending timeouts, with O(1) insertion and removal,
+ * and a per-tick cost that doesn't depend on how many timeouts are armed.
+ *
+ * The wheel has TIMINGWHEEL_LEVELS levels of TIMINGWHEEL_SLOTS slots each, every slot being a list of entries.
+ * Level 0 holds the entries expiring within the next 32 ticks, one slot per tick; each level above covers
+ * a 32 times longer range, with slots 32 times coarser. When the slot of level 0 wraps around, the current
+ * slot of level 1 is cascaded, that is, its entries are moved to level 0, and so on up the levels.
+ * An entry is moved at most once per level, so expiry takes amortised constant time.
+ * A bitmap per level, resolved with CLZ, tells which slots are not empty.
+ *
+ * The wheel doesn't protect itself from concurrent accesses: the kernel uses one, driven by OS_Tick, for both the
+ * threads' timeouts and the timeouts armed with OS_Timeout_Start, which is the API to use in the application.
+ *
+ * Example:
+ * ```c
+ * #include "timing_wheel.h"
+ *
+ * TimingWheel_t wheel;
+ * TimingWheel_Init(&wheel);
+ *
+ * TimingWheelEntry_t entry = {0};
+ * TimingWheel_Insert(&wheel, &entry, 100);
+ *
+ * // every tick
+ * TimingWheelEntry_t *expired = NULL;
+ * TimingWheel_Tick(&wheel, &expired);
+ * while (expired != NULL)
+ * {
+ *     TimingWheelEntry_t *expired_entry = expired;
+ *     TimingWheel_Remove(&wheel, expired_entry);
+ *     // handle the expired entry
+ * }
+ * ```
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMINGWHEEL_SLOT_BITS 5 /* Number of bits of the tick that select a slot, on each level */
+#define TIMINGWHEEL_SLOTS (1U << TIMINGWHEEL_SLOT_BITS)
+#define TIMINGWHEEL_LEVELS 6 /* 6 levels cover 2^30 ticks, more than 12 days at 1 kHz */
+#define TIMINGWHEEL_MAX_TICKS (1U << (TIMINGWHEEL_SLOT_BITS * TIMINGWHEEL_LEVELS))
+
+/**
+ * A value of type *TimingWheelEntry_t should be zero-initialized before it's inserted for the first time.
+ * The wheel only uses the next, link and expiry fields, callback and arg are left to the wheel's owner.
+ */
+typedef struct TimingWheelEntry
+{
+    struct TimingWheelEntry *next;  /* Next entry in the same list, NULL if last */
+    struct TimingWheelEntry **link; /* Pointer to this entry in its list, NULL if not armed */
+    uint32_t expiry;                /* Tick at which the entry expires, valid while armed */
+    void (*callback)(void *arg);    /* Run by the wheel's owner when the entry expires */
+    void *arg;                      /* Passed to the callback */
+} TimingWheelEntry_t;
+
+typedef struct
+{
+    TimingWheelEntry_t *slots[TIMINGWHEEL_LEVELS][TIMINGWHEEL_SLOTS];
+    uint32_t bitmaps[TIMINGWHEEL_LEVELS]; /* Bit (31 - s) of bitmaps[l] is set when slots[l][s] is not empty */
+    uint32_t now;                         /* Next tick to be processed by TimingWheel_Tick */
+} TimingWheel_t;
+
+/**
+ * The fn TimingWheel_Init empties the wheel.
+ */
+void TimingWheel_Init(TimingWheel_t *wheel);
+
+/**
+ * The fn TimingWheel_Insert arms the entry, which mustn't be armed already, so that it expires on the ticks-th
+ * call to TimingWheel_Tick from now (0 behaves as 1, longer timeouts than TIMINGWHEEL_MAX_TICKS are capped).
+ * The fn TimingWheel_Remove disarms the entry, either still pending or in the list of expired entries.
+ * The fn TimingWheel_IsArmed returns whether the entry is part of either.
+ * They all take constant time.
+ */
+void TimingWheel_Insert(TimingWheel_t *wheel, TimingWheelEntry_t *entry, uint32_t ticks);
+
+void TimingWheel_Remove(TimingWheel_t *wheel, TimingWheelEntry_t *entry);
+
+bool TimingWheel_IsArmed(const TimingWheelEntry_t *entry);
+
+/**
+ * The fn TimingWheel_Tick advances the wheel by one tick, and moves the entries that expire on that tick
+ * to the list expired, which must be empty. The entries stay armed, linked through their next field, until
+ * they're removed with TimingWheel_Remove, so they can still be cancelled while the caller goes through them.
+ * The expired slot is moved as a whole, and cascades happen once every 32 ticks at most: the average cost
+ * per tick doesn't depend on the number of entries.
+ */
+void TimingWheel_Tick(TimingWheel_t *wheel, TimingWheelEntry_t **expired);
+
+/**
+ * The fn TimingWheel_GetIdleTicks returns the number of calls to TimingWheel_Tick until one of them has
+ * something to do, expiring or cascading entries, UINT32_MAX if the wheel is empty.
+ * The fn TimingWheel_Skip advances the wheel by fewer ticks than that at once, for the tickless idle mode.
+ */
+uint32_t TimingWheel_GetIdleTicks(const TimingWheel_t *wheel);
+
+void TimingWheel_Skip(TimingWheel_t *wheel, uint32_t ticks);
@@ -1,5 +1,6 @@
 /**
- * The module user_tasks provides dummy tasks to be run by the OS.
+ * The module user_tasks provides dummy tasks to be run by the OS, and benchmarks of the kernel fns.
+ * main.c runs either the dummy tasks or, with MAIN_RUN_BENCHMARK, one of the benchmarks alone.
  */
 
 #pragma once
@@ -8,3 +9,93 @@ void UserTask_0(void);
 void UserTask_1(void);
 void UserTask_2(void);
 void UserTask_3(void);
+
+/**
+ * The fn UserTask_FifoBenchmark measures the cycles per item moved through a FifoQueue with
+ * FifoQueue_PutN and FifoQueue_GetN, for batches of 1, 8 and FIFOQUEUE_SIZE items, the largest the FIFO holds,
+ * stores the results in FifoBenchmarkCyclesPerItem, then kills itself.
+ * Create it with the highest priority, so that other threads don't skew the results.
+ */
+void UserTask_FifoBenchmark(void);
+
+/**
+ * The fn UserTask_WakeupBenchmark measures the cycles it takes to wake up a blocked thread of higher priority,
+ * from the call that wakes it up to the thread running, through a semaphore and through a notification.
+ * It then measures the event-to-thread latency, from pending an interrupt to the thread running, with the
+ * ISR UserTask_WakeupBenchmarkIRQHandler signaling the semaphore.
+ * It stores the averages in WakeupBenchmarkSemaphoreCycles, WakeupBenchmarkNotifyCycles and WakeupBenchmarkISRCycles,
+ * then kills itself.
+ * Create it with a priority just below OS_SCHEDL_PRIO_MAX, as its waiters run at OS_SCHEDL_PRIO_MAX.
+ *
+ * The fn UserTask_WakeupBenchmarkIRQHandler is called by the EXTI1 ISR, which no pin is connected to.
+ */
+void UserTask_WakeupBenchmark(void);
+void UserTask_WakeupBenchmarkIRQHandler(void);
+
+/**
+ * The fn UserTask_TimingWheelBenchmark measures the cycles the SysTick ISR takes, OS_Tick included, with 10, 100
+ * and 1000 timeouts armed with OS_Timeout_Start for random durations, their callbacks re-arming them when they
+ * expire. It stores the average and the maximum in TimingWheelBenchmarkAverageCycles and
+ * TimingWheelBenchmarkMaxCycles, then kills itself. The maximum includes the cascades.
+ * Create it alone: it drives the ticks itself, with the SysTick and SchedlTimer interrupts off, so the other
+ * threads' sleeps and timeouts would expire early.
+ */
+void UserTask_TimingWheelBenchmark(void);
+
+/**
+ * The fn UserTask_SchedulerBenchmark measures the cycles OS_Scheduler takes to pick the next thread with
+ * 4, 10 and 64 threads, and the cycles the linear scan of the TCB ring it replaced would take with as many TCBs.
+ * It stores the averages in SchedulerBenchmarkBitmapCycles and SchedulerBenchmarkLinearCycles, then kills itself.
+ * OS_Scheduler is measured only up to MAXNUMTHREADS threads: raise it to 64, and OS_STACKPOOL_SIZE to match,
+ * to measure all of them.
+ * Create it alone, with a priority just below OS_SCHEDL_PRIO_MAX: it calls OS_Scheduler while it's the
+ * thread to run, so that RunPt doesn't change.
+ */
+void UserTask_SchedulerBenchmark(void);
+
+/**
+ * The fn UserTask_SleepTest sleeps for several durations, from 1 to 1000 ms, and panics if a sleep isn't within
+ * one tick of the duration asked, measured with HAL_GetTick. It stores the longest sleep measured for each
+ * duration in SleepTestMaxElapsedMs, then kills itself.
+ * Create it alone, so that the tick is suppressed while it sleeps, if OS_TICKLESS_IDLE is enabled.
+ */
+void UserTask_SleepTest(void);
+
+/**
+ * The fn UserTask_ContextSwitchBenchmark measures the cycles it takes to switch between two threads of the same
+ * priority, from one yielding to the other running, first for threads that never use the FPU, then for threads
+ * that use it before each switch, so that their FP context is saved and restored too.
+ * It stores the averages in ContextSwitchBenchmarkCycles and ContextSwitchBenchmarkFPCycles, measures both again
+ * while the DMA keeps copying between two words of SRAM, storing them in ContextSwitchBenchmarkDMACycles and
+ * ContextSwitchBenchmarkDMAFPCycles, then kills itself.
+ * Run it both with OS_USE_CCMRAM set to 0 and to 1, to compare switches contending the bus matrix with the DMA
+ * against switches out of CCM RAM.
+ * Create it with a priority just below OS_SCHEDL_PRIO_MAX, as its workers run at OS_SCHEDL_PRIO_MAX + 2.
+ */
+void UserTask_ContextSwitchBenchmark(void);
+
+/**
+ * The fn UserTask_PriorityInversionTest recreates a priority inversion: a low priority thread holds an OS_Mutex
+ * for a critical section of PRIORITYINVERSIONTEST_CS_MS, while a medium priority one hogs the CPU and a high
+ * priority one locks the same mutex. It asserts that the high priority thread is blocked for one critical section
+ * at most, then, with a mutex held by a thread blocked on a second mutex, for two critical sections at most.
+ * It stores the cycles measured in PriorityInversionTestBlockingCycles and PriorityInversionTestChainedBlockingCycles,
+ * then kills itself.
+ * Create it with a priority just below OS_SCHEDL_PRIO_MAX, as its workers run from OS_SCHEDL_PRIO_MAX + 2 down.
+ */
+void UserTask_PriorityInversionTest(void);
+
+/**
+ * The fn UserTask_InterruptLatencyBenchmark measures the worst-case latency of the TIM7 update interrupt, from
+ * the update event to its ISR reading the timer's counter, while two threads keep waking up each other through
+ * semaphores, entering and leaving kernel critical sections. It runs once with the interrupt above the kernel
+ * ceiling, where critical sections don't mask it, then at the ceiling, where they mask it as the former global
+ * interrupt disable did. It stores the results in InterruptLatencyBenchmarkZeroLatencyCycles and
+ * InterruptLatencyBenchmarkMaskedCycles, then kills itself.
+ * Create it with a priority just below OS_SCHEDL_PRIO_MAX, as its threads run at OS_SCHEDL_PRIO_MAX + 2.
+ *
+ * The fn UserTask_InterruptLatencyBenchmarkIRQHandler is called by the TIM7 ISR. It doesn't call any kernel fn,
+ * so it can run above the ceiling.
+ */
+void UserTask_InterruptLatencyBenchmark(void);
+void UserTask_InterruptLatencyBenchmarkIRQHandler(void);
@@ -4,6 +4,7 @@
 
 #include "fifo_queue.h"
 
+#include "iferr.h"
 #include <string.h>
 
 //==================================================================================================
@@ -27,6 +28,18 @@
 // STATIC PROTOTYPES
 //==================================================================================================
 
+/**
+ * The fn FifoQueue_Push and FifoQueue_Pop copy one item in or out of the FIFO and move the pointer,
+ * wrapping at the end. The caller must have taken a slot through the semaphores and locked the FIFO's mutex.
+ */
+static void FifoQueue_Push(FifoQueue_t *fifo, uint32_t item);
+static uint32_t FifoQueue_Pop(FifoQueue_t *fifo);
+
+/**
+ * The fn FifoQueue_GetRemainingMs returns how much of timeout_ms is left since start_tick, 0 if it's over.
+ */
+static uint32_t FifoQueue_GetRemainingMs(uint32_t start_tick, uint32_t timeout_ms);
+
 //==================================================================================================
 // STATIC VARIABLES
 //==================================================================================================
@@ -39,16 +52,134 @@ void FifoQueue_Init(FifoQueue_t *fifo)
 {
     memset(fifo_data, 0x00, FIFOQUEUE_SIZE * sizeof(uint32_t));
     fifo_put_pt = fifo_get_pt = &fifo_data[0];
-    fifo_current_size = 0;
-    fifo_room_left = FIFOQUEUE_SIZE;
-    fifo_mutex = 1;
+    OS_Semaphore_Init(&fifo_current_size, 0);
+    OS_Semaphore_Init(&fifo_room_left, FIFOQUEUE_SIZE);
+    OS_Mutex_Init(&fifo_mutex);
 }
 
 void FifoQueue_Put(FifoQueue_t *fifo, uint32_t item)
 {
     OS_Semaphore_Wait(&fifo_room_left);
-    OS_Semaphore_Wait(&fifo_mutex);
+    OS_Mutex_Lock(&fifo_mutex);
+    FifoQueue_Push(fifo, item);
+    OS_Mutex_Unlock(&fifo_mutex);
+    OS_Semaphore_Signal(&fifo_current_size);
+}
+
+uint32_t FifoQueue_Get(FifoQueue_t *fifo)
+{
+    OS_Semaphore_Wait(&fifo_current_size);
+    OS_Mutex_Lock(&fifo_mutex);
+    uint32_t item = FifoQueue_Pop(fifo);
+    OS_Mutex_Unlock(&fifo_mutex);
+    OS_Semaphore_Signal(&fifo_room_left);
+    return item;
+}
+
+HAL_StatusTypeDef FifoQueue_PutTimeout(FifoQueue_t *fifo, uint32_t item, uint32_t timeout_ms)
+{
+    /* The timeout covers both waiting for room and for the mutex: if the mutex can't be taken in time,
+     * the slot goes back to the semaphore */
+    uint32_t start_tick = HAL_GetTick();
+    IFERR_RETE(OS_Semaphore_WaitTimeout(&fifo_room_left, timeout_ms));
+    if (OS_Mutex_LockTimeout(&fifo_mutex, FifoQueue_GetRemainingMs(start_tick, timeout_ms)) != HAL_OK)
+    {
+        OS_Semaphore_Signal(&fifo_room_left);
+        return HAL_TIMEOUT;
+    }
+    FifoQueue_Push(fifo, item);
+    OS_Mutex_Unlock(&fifo_mutex);
+    OS_Semaphore_Signal(&fifo_current_size);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef FifoQueue_GetTimeout(FifoQueue_t *fifo, uint32_t *item, uint32_t timeout_ms)
+{
+    uint32_t start_tick = HAL_GetTick();
+    IFERR_RETE(OS_Semaphore_WaitTimeout(&fifo_current_size, timeout_ms));
+    if (OS_Mutex_LockTimeout(&fifo_mutex, FifoQueue_GetRemainingMs(start_tick, timeout_ms)) != HAL_OK)
+    {
+        OS_Semaphore_Signal(&fifo_current_size);
+        return HAL_TIMEOUT;
+    }
+    *item = FifoQueue_Pop(fifo);
+    OS_Mutex_Unlock(&fifo_mutex);
+    OS_Semaphore_Signal(&fifo_room_left);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef FifoQueue_TryPut(FifoQueue_t *fifo, uint32_t item)
+{
+    IFERR_RETE(OS_Semaphore_TryWait(&fifo_room_left));
+    if (OS_Mutex_TryLock(&fifo_mutex) != HAL_OK)
+    {
+        OS_Semaphore_Signal(&fifo_room_left);
+        return HAL_BUSY;
+    }
+    FifoQueue_Push(fifo, item);
+    OS_Mutex_Unlock(&fifo_mutex);
+    OS_Semaphore_Signal(&fifo_current_size);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef FifoQueue_TryGet(FifoQueue_t *fifo, uint32_t *item)
+{
+    IFERR_RETE(OS_Semaphore_TryWait(&fifo_current_size));
+    if (OS_Mutex_TryLock(&fifo_mutex) != HAL_OK)
+    {
+        OS_Semaphore_Signal(&fifo_current_size);
+        return HAL_BUSY;
+    }
+    *item = FifoQueue_Pop(fifo);
+    OS_Mutex_Unlock(&fifo_mutex);
+    OS_Semaphore_Signal(&fifo_room_left);
+    return HAL_OK;
+}
 
+uint32_t FifoQueue_PutN(FifoQueue_t *fifo, const uint32_t *items, uint32_t count)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint32_t put_count = OS_Semaphore_WaitUpTo(&fifo_room_left, count);
+    OS_Mutex_Lock(&fifo_mutex);
+
+    for (uint32_t idx = 0; idx < put_count; idx++)
+    {
+        FifoQueue_Push(fifo, items[idx]);
+    }
+
+    OS_Mutex_Unlock(&fifo_mutex);
+    OS_Semaphore_SignalN(&fifo_current_size, put_count);
+    return put_count;
+}
+
+uint32_t FifoQueue_GetN(FifoQueue_t *fifo, uint32_t *items, uint32_t count)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint32_t get_count = OS_Semaphore_WaitUpTo(&fifo_current_size, count);
+    OS_Mutex_Lock(&fifo_mutex);
+
+    for (uint32_t idx = 0; idx < get_count; idx++)
+    {
+        items[idx] = FifoQueue_Pop(fifo);
+    }
+
+    OS_Mutex_Unlock(&fifo_mutex);
+    OS_Semaphore_SignalN(&fifo_room_left, get_count);
+    return get_count;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static void FifoQueue_Push(FifoQueue_t *fifo, uint32_t item)
+{
     *fifo_put_pt = item;
     fifo_put_pt++;
     if (fifo_put_pt == &fifo_data[FIFOQUEUE_SIZE])
@@ -56,16 +187,10 @@ void FifoQueue_Put(FifoQueue_t *fifo, uint32_t item)
         /* Wrap */
         fifo_put_pt = &fifo_data[0];
     }
-
-    OS_Semaphore_Signal(&fifo_mutex);
-    OS_Semaphore_Signal(&fifo_current_size);
 }
 
-uint32_t FifoQueue_Get(FifoQueue_t *fifo)
+static uint32_t FifoQueue_Pop(FifoQueue_t *fifo)
 {
-    OS_Semaphore_Wait(&fifo_current_size);
-    OS_Semaphore_Wait(&fifo_mutex);
-
     uint32_t item = *fifo_get_pt;
     fifo_get_pt++;
     if (fifo_get_pt == &fifo_data[FIFOQUEUE_SIZE])
@@ -73,12 +198,11 @@ uint32_t FifoQueue_Get(FifoQueue_t *fifo)
         /* Wrap */
         fifo_get_pt = &fifo_data[0];
     }
-
-    OS_Semaphore_Signal(&fifo_mutex);
-    OS_Semaphore_Signal(&fifo_room_left);
     return item;
 }
 
-//==================================================================================================
-// STATIC FUNCTIONS
-//==================================================================================================
+static uint32_t FifoQueue_GetRemainingMs(uint32_t start_tick, uint32_t timeout_ms)
+{
+    uint32_t elapsed_ms = HAL_GetTick() - start_tick;
+    return (elapsed_ms < timeout_ms) ? (timeout_ms - elapsed_ms) : 0;
+}
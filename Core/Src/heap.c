@@ -0,0 +1,478 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "heap.h"
+
+#include "iferr.h"
+#include "os.h"
+
+#include "stm32f3xx_hal.h"
+#include <errno.h>
+#include <malloc.h>
+#include <reent.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define HEAP_ALIGN 8                                 /* Alignment of every block, as required by the AAPCS */
+#define HEAP_SL_LOG2 4                               /* Log2 of the number of second level lists per first level */
+#define HEAP_SL_COUNT (1U << HEAP_SL_LOG2)           /* Number of second level lists per first level */
+#define HEAP_FL_SHIFT (HEAP_SL_LOG2 + 3)             /* Log2 of the size under which blocks are split linearly */
+#define HEAP_SMALL_BLOCK_SIZE (1U << HEAP_FL_SHIFT)  /* Blocks smaller than this are all in the first level 0 */
+#define HEAP_FL_MAX 16                               /* Log2 of the size limit of a block, above the 40K of RAM */
+#define HEAP_FL_COUNT (HEAP_FL_MAX - HEAP_FL_SHIFT + 1) /* Number of first levels */
+
+#define HEAP_BLOCK_FREE 0x1U      /* Flag set in the block's size if the block is free */
+#define HEAP_BLOCK_PREV_FREE 0x2U /* Flag set in the block's size if the previous block in memory is free */
+#define HEAP_BLOCK_FLAGS (HEAP_BLOCK_FREE | HEAP_BLOCK_PREV_FREE)
+
+/* A block's header is followed by its payload, the free list links are stored in the payload of free blocks */
+#define HEAP_HEADER_SIZE (offsetof(HeapBlock_t, next_free))
+#define HEAP_MIN_BLOCK_SIZE (sizeof(HeapBlock_t) - HEAP_HEADER_SIZE)
+#define HEAP_MAX_BLOCK_SIZE ((1U << HEAP_FL_MAX) - 1)
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+typedef struct HeapBlock
+{
+    struct HeapBlock *prev_phys; /* Previous block in memory, only valid if HEAP_BLOCK_PREV_FREE is set */
+    uint32_t size;               /* Payload size, multiple of HEAP_ALIGN, ORed with the flags */
+    struct HeapBlock *next_free; /* Next block in the same free list, only valid if the block is free */
+    struct HeapBlock *prev_free; /* Previous block in the same free list, only valid if the block is free */
+} HeapBlock_t;
+
+_Static_assert(sizeof(HeapBlock_t) % HEAP_ALIGN == 0 && HEAP_HEADER_SIZE % HEAP_ALIGN == 0, "misaligned block");
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+/**
+ * The fn Heap_Init turns the region between _sheap and _eheap into a single free block,
+ * followed by a zero-sized used block, so that every block has a next one.
+ */
+static void Heap_Init(void);
+
+/**
+ * The fn Heap_Mapping returns the first and second level indexes of the free list for the size.
+ * The fn Heap_FindFree returns a free block at least size bytes large in O(1), NULL if none.
+ * It rounds the size up to the next list, so that any block in the list found is large enough.
+ */
+static void Heap_Mapping(uint32_t size, uint32_t *fl, uint32_t *sl);
+static HeapBlock_t *Heap_FindFree(uint32_t size);
+
+/**
+ * The fn Heap_InsertFree adds the block at the head of its free list.
+ * The fn Heap_RemoveFree unlinks the block from its free list.
+ */
+static void Heap_InsertFree(HeapBlock_t *block);
+static void Heap_RemoveFree(HeapBlock_t *block);
+
+/**
+ * The fn Heap_Release merges the block with its free neighbours, then adds it to the free lists.
+ * The fn Heap_Trim shrinks the block to size, releasing the rest if it's large enough for a block.
+ */
+static void Heap_Release(HeapBlock_t *block);
+static void Heap_Trim(HeapBlock_t *block, uint32_t size);
+
+/**
+ * The fn Heap_SetFree and Heap_SetUsed update the block's flag, and the one of the next block.
+ */
+static void Heap_SetFree(HeapBlock_t *block);
+static void Heap_SetUsed(HeapBlock_t *block);
+
+static uint32_t Heap_BlockSize(HeapBlock_t *block);
+static HeapBlock_t *Heap_NextBlock(HeapBlock_t *block);
+
+/**
+ * The fn Heap_AdjustSize rounds the requested size up to a valid block size, 0 if it's too large.
+ */
+static uint32_t Heap_AdjustSize(size_t size);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+/* FreeLists[fl][sl] points to the first free block of the size class, NULL if none.
+ * Bit fl of FlBitmap is set when SlBitmaps[fl] is not zero,
+ * bit sl of SlBitmaps[fl] is set when FreeLists[fl][sl] is not empty */
+static HeapBlock_t *FreeLists[HEAP_FL_COUNT][HEAP_SL_COUNT];
+static uint32_t FlBitmap;
+static uint32_t SlBitmaps[HEAP_FL_COUNT];
+
+static bool IsInitialized;
+
+/* Bytes managed by the heap, and bytes in the used blocks, headers included */
+static uint32_t TotalBytes;
+static uint32_t UsedBytes;
+static uint32_t PeakUsedBytes;
+
+/* Taken by __malloc_lock, a zero-initialized mutex is free */
+static Mutex_t HeapMutex;
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void *_malloc_r(struct _reent *reent, size_t size)
+{
+    uint32_t block_size = Heap_AdjustSize(size);
+    if (block_size == 0)
+    {
+        reent->_errno = ENOMEM;
+        return NULL;
+    }
+
+    __malloc_lock(reent);
+    if (!IsInitialized)
+    {
+        Heap_Init();
+    }
+    HeapBlock_t *block = Heap_FindFree(block_size);
+    if (block == NULL)
+    {
+        __malloc_unlock(reent);
+        reent->_errno = ENOMEM;
+        return NULL;
+    }
+
+    Heap_RemoveFree(block);
+    Heap_SetUsed(block);
+    Heap_Trim(block, block_size);
+    UsedBytes += HEAP_HEADER_SIZE + Heap_BlockSize(block);
+    if (UsedBytes > PeakUsedBytes)
+    {
+        PeakUsedBytes = UsedBytes;
+    }
+    __malloc_unlock(reent);
+    return (uint8_t *)block + HEAP_HEADER_SIZE;
+}
+
+void _free_r(struct _reent *reent, void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    HeapBlock_t *block = (HeapBlock_t *)((uint8_t *)ptr - HEAP_HEADER_SIZE);
+    assert_or_panic((block->size & HEAP_BLOCK_FREE) == 0);
+
+    __malloc_lock(reent);
+    UsedBytes -= HEAP_HEADER_SIZE + Heap_BlockSize(block);
+    Heap_Release(block);
+    __malloc_unlock(reent);
+}
+
+void *_calloc_r(struct _reent *reent, size_t num_items, size_t item_size)
+{
+    if ((item_size != 0) && (num_items > SIZE_MAX / item_size))
+    {
+        reent->_errno = ENOMEM;
+        return NULL;
+    }
+
+    void *ptr = _malloc_r(reent, num_items * item_size);
+    if (ptr != NULL)
+    {
+        memset(ptr, 0x00, num_items * item_size);
+    }
+    return ptr;
+}
+
+void *_realloc_r(struct _reent *reent, void *ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return _malloc_r(reent, size);
+    }
+    if (size == 0)
+    {
+        _free_r(reent, ptr);
+        return NULL;
+    }
+    uint32_t block_size = Heap_AdjustSize(size);
+    if (block_size == 0)
+    {
+        reent->_errno = ENOMEM;
+        return NULL;
+    }
+
+    __malloc_lock(reent);
+    HeapBlock_t *block = (HeapBlock_t *)((uint8_t *)ptr - HEAP_HEADER_SIZE);
+    uint32_t old_size = Heap_BlockSize(block);
+    UsedBytes -= HEAP_HEADER_SIZE + old_size;
+
+    /* Grow in place, if the next block is free and large enough */
+    HeapBlock_t *next_block = Heap_NextBlock(block);
+    if ((block_size > old_size) && (next_block->size & HEAP_BLOCK_FREE) &&
+        (old_size + HEAP_HEADER_SIZE + Heap_BlockSize(next_block) >= block_size))
+    {
+        Heap_RemoveFree(next_block);
+        block->size += HEAP_HEADER_SIZE + Heap_BlockSize(next_block);
+        Heap_SetUsed(block);
+    }
+
+    if (block_size <= Heap_BlockSize(block))
+    {
+        Heap_Trim(block, block_size);
+        UsedBytes += HEAP_HEADER_SIZE + Heap_BlockSize(block);
+        if (UsedBytes > PeakUsedBytes)
+        {
+            PeakUsedBytes = UsedBytes;
+        }
+        __malloc_unlock(reent);
+        return ptr;
+    }
+
+    /* The lock is recursive, so the block is moved atomically */
+    UsedBytes += HEAP_HEADER_SIZE + Heap_BlockSize(block);
+    void *new_ptr = _malloc_r(reent, size);
+    if (new_ptr != NULL)
+    {
+        memcpy(new_ptr, ptr, old_size);
+        _free_r(reent, ptr);
+    }
+    __malloc_unlock(reent);
+    return new_ptr;
+}
+
+void __malloc_lock(struct _reent *reent)
+{
+    /* Before the OS is launched there's a single thread of execution */
+    if (!OS_IsRunning())
+    {
+        return;
+    }
+    assert_or_panic(__get_IPSR() == 0);
+    OS_Mutex_Lock(&HeapMutex);
+}
+
+void __malloc_unlock(struct _reent *reent)
+{
+    if (!OS_IsRunning())
+    {
+        return;
+    }
+    OS_Mutex_Unlock(&HeapMutex);
+}
+
+void Heap_GetStats(HeapStats_t *stats)
+{
+    __malloc_lock(_REENT);
+    if (!IsInitialized)
+    {
+        Heap_Init();
+    }
+
+    uint32_t free_bytes = 0;
+    uint32_t largest_free_block = 0;
+    for (uint32_t fl = 0; fl < HEAP_FL_COUNT; fl++)
+    {
+        for (uint32_t sl = 0; sl < HEAP_SL_COUNT; sl++)
+        {
+            for (HeapBlock_t *block = FreeLists[fl][sl]; block != NULL; block = block->next_free)
+            {
+                free_bytes += HEAP_HEADER_SIZE + Heap_BlockSize(block);
+                if (Heap_BlockSize(block) > largest_free_block)
+                {
+                    largest_free_block = Heap_BlockSize(block);
+                }
+            }
+        }
+    }
+
+    stats->total_bytes = TotalBytes;
+    stats->free_bytes = free_bytes;
+    stats->largest_free_block = largest_free_block;
+    stats->peak_used_bytes = PeakUsedBytes;
+    stats->fragmentation_percent =
+        (free_bytes == 0) ? 0 : (free_bytes - HEAP_HEADER_SIZE - largest_free_block) * 100U / free_bytes;
+    __malloc_unlock(_REENT);
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static void Heap_Init(void)
+{
+    extern uint8_t _sheap; /* Symbol defined in the linker script */
+    extern uint8_t _eheap; /* Symbol defined in the linker script */
+    uint32_t start = ((uint32_t)&_sheap + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    uint32_t end = (uint32_t)&_eheap & ~(HEAP_ALIGN - 1);
+    assert_or_panic(end > start + 2 * HEAP_HEADER_SIZE + HEAP_MIN_BLOCK_SIZE);
+    assert_or_panic(end - start - 2 * HEAP_HEADER_SIZE <= HEAP_MAX_BLOCK_SIZE);
+
+    HeapBlock_t *block = (HeapBlock_t *)start;
+    block->size = end - start - 2 * HEAP_HEADER_SIZE;
+    HeapBlock_t *sentinel = Heap_NextBlock(block);
+    sentinel->size = 0;
+    Heap_Release(block);
+
+    TotalBytes = end - start - HEAP_HEADER_SIZE;
+    IsInitialized = true;
+}
+
+static void Heap_Mapping(uint32_t size, uint32_t *fl, uint32_t *sl)
+{
+    if (size < HEAP_SMALL_BLOCK_SIZE)
+    {
+        *fl = 0;
+        *sl = size / (HEAP_SMALL_BLOCK_SIZE / HEAP_SL_COUNT);
+        return;
+    }
+    uint32_t msb = 31 - __CLZ(size);
+    *fl = msb - (HEAP_FL_SHIFT - 1);
+    *sl = (size >> (msb - HEAP_SL_LOG2)) ^ HEAP_SL_COUNT;
+}
+
+static HeapBlock_t *Heap_FindFree(uint32_t size)
+{
+    if (size >= HEAP_SMALL_BLOCK_SIZE)
+    {
+        size += (1U << (31 - __CLZ(size) - HEAP_SL_LOG2)) - 1;
+    }
+    uint32_t fl;
+    uint32_t sl;
+    Heap_Mapping(size, &fl, &sl);
+    if (fl >= HEAP_FL_COUNT)
+    {
+        return NULL;
+    }
+
+    /* The lowest set bit is found with CLZ on the bit-reversed map */
+    uint32_t sl_map = SlBitmaps[fl] & (~0U << sl);
+    if (sl_map == 0)
+    {
+        uint32_t fl_map = FlBitmap & (~0U << (fl + 1));
+        if (fl_map == 0)
+        {
+            return NULL;
+        }
+        fl = __CLZ(__RBIT(fl_map));
+        sl_map = SlBitmaps[fl];
+    }
+    sl = __CLZ(__RBIT(sl_map));
+    return FreeLists[fl][sl];
+}
+
+static void Heap_InsertFree(HeapBlock_t *block)
+{
+    uint32_t fl;
+    uint32_t sl;
+    Heap_Mapping(Heap_BlockSize(block), &fl, &sl);
+    block->prev_free = NULL;
+    block->next_free = FreeLists[fl][sl];
+    if (block->next_free != NULL)
+    {
+        block->next_free->prev_free = block;
+    }
+    FreeLists[fl][sl] = block;
+    FlBitmap |= (1U << fl);
+    SlBitmaps[fl] |= (1U << sl);
+}
+
+static void Heap_RemoveFree(HeapBlock_t *block)
+{
+    uint32_t fl;
+    uint32_t sl;
+    Heap_Mapping(Heap_BlockSize(block), &fl, &sl);
+    if (block->next_free != NULL)
+    {
+        block->next_free->prev_free = block->prev_free;
+    }
+    if (block->prev_free != NULL)
+    {
+        block->prev_free->next_free = block->next_free;
+        return;
+    }
+
+    FreeLists[fl][sl] = block->next_free;
+    if (FreeLists[fl][sl] == NULL)
+    {
+        SlBitmaps[fl] &= ~(1U << sl);
+        if (SlBitmaps[fl] == 0)
+        {
+            FlBitmap &= ~(1U << fl);
+        }
+    }
+}
+
+static void Heap_Release(HeapBlock_t *block)
+{
+    if (block->size & HEAP_BLOCK_PREV_FREE)
+    {
+        HeapBlock_t *prev_block = block->prev_phys;
+        Heap_RemoveFree(prev_block);
+        prev_block->size += HEAP_HEADER_SIZE + Heap_BlockSize(block);
+        block = prev_block;
+    }
+
+    HeapBlock_t *next_block = Heap_NextBlock(block);
+    if (next_block->size & HEAP_BLOCK_FREE)
+    {
+        Heap_RemoveFree(next_block);
+        block->size += HEAP_HEADER_SIZE + Heap_BlockSize(next_block);
+    }
+
+    Heap_SetFree(block);
+    Heap_InsertFree(block);
+}
+
+static void Heap_Trim(HeapBlock_t *block, uint32_t size)
+{
+    uint32_t block_size = Heap_BlockSize(block);
+    if (block_size < size + HEAP_HEADER_SIZE + HEAP_MIN_BLOCK_SIZE)
+    {
+        return;
+    }
+
+    /* The block is used, so the remaining block's previous one isn't free */
+    block->size = size | (block->size & HEAP_BLOCK_FLAGS);
+    HeapBlock_t *remaining_block = Heap_NextBlock(block);
+    remaining_block->size = block_size - size - HEAP_HEADER_SIZE;
+    Heap_Release(remaining_block);
+}
+
+static void Heap_SetFree(HeapBlock_t *block)
+{
+    block->size |= HEAP_BLOCK_FREE;
+    HeapBlock_t *next_block = Heap_NextBlock(block);
+    next_block->prev_phys = block;
+    next_block->size |= HEAP_BLOCK_PREV_FREE;
+}
+
+static void Heap_SetUsed(HeapBlock_t *block)
+{
+    block->size &= ~HEAP_BLOCK_FREE;
+    Heap_NextBlock(block)->size &= ~HEAP_BLOCK_PREV_FREE;
+}
+
+static uint32_t Heap_BlockSize(HeapBlock_t *block)
+{
+    return block->size & ~HEAP_BLOCK_FLAGS;
+}
+
+static HeapBlock_t *Heap_NextBlock(HeapBlock_t *block)
+{
+    return (HeapBlock_t *)((uint8_t *)block + HEAP_HEADER_SIZE + Heap_BlockSize(block));
+}
+
+static uint32_t Heap_AdjustSize(size_t size)
+{
+    if (size > HEAP_MAX_BLOCK_SIZE)
+    {
+        return 0;
+    }
+    uint32_t block_size = (size + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    return (block_size < HEAP_MIN_BLOCK_SIZE) ? HEAP_MIN_BLOCK_SIZE : block_size;
+}
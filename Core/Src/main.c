@@ -13,6 +13,12 @@
 // DEFINES - MACROS
 //==================================================================================================
 
+/* Run one of the benchmarks declared in user_tasks.h instead of the demo tasks (1) or not (0).
+ * The benchmark runs alone, just below OS_SCHEDL_PRIO_MAX so that the threads it creates can preempt it,
+ * and leaves its results in static variables of user_tasks.c, to be inspected with the debugger */
+#define MAIN_RUN_BENCHMARK 0
+#define MAIN_BENCHMARK_TASK UserTask_FifoBenchmark
+
 //==================================================================================================
 // ENUMS - STRUCTS - TYPEDEFS
 //==================================================================================================
@@ -40,10 +46,14 @@ int main(void)
 
     /* Set up and start the OS */
     OS_Init(THREADFREQ);
-    OS_Thread_CreateFirst(UserTask_0, OS_SCHEDL_PRIO_MAIN_THREAD, "UserTask_0");
-    OS_Thread_Create(UserTask_1, OS_SCHEDL_PRIO_MAIN_THREAD, "UserTask_1");
-    OS_Thread_Create(UserTask_2, OS_SCHEDL_PRIO_MAIN_THREAD, "UserTask_2");
-    OS_Thread_Create(OnboardUserButton_Task, OS_SCHEDL_PRIO_EVENT_THREAD, "OnboardUserButton_Task");
+#if MAIN_RUN_BENCHMARK
+    OS_Thread_CreateFirst(MAIN_BENCHMARK_TASK, OS_SCHEDL_PRIO_MAX + 1, "Benchmark", STACKSIZE);
+#else
+    OS_Thread_CreateFirst(UserTask_0, OS_SCHEDL_PRIO_MAIN_THREAD, "UserTask_0", STACKSIZE);
+    OS_Thread_Create(UserTask_1, OS_SCHEDL_PRIO_MAIN_THREAD, "UserTask_1", STACKSIZE);
+    OS_Thread_Create(UserTask_2, OS_SCHEDL_PRIO_MAIN_THREAD, "UserTask_2", STACKSIZE);
+    OS_Thread_Create(OnboardUserButton_Task, OS_SCHEDL_PRIO_EVENT_THREAD, "OnboardUserButton_Task", OS_STACKSIZE_MIN);
+#endif
     OS_Launch();
 
     /* This statement should not be reached */
@@ -0,0 +1,114 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "mem_pool.h"
+
+#include "iferr.h"
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+/**
+ * The fn MemPool_Pop unlinks the first block of the free list, which can't be empty since the caller
+ * already took one unit of the free_blocks semaphore, and updates the usage stats.
+ */
+static void *MemPool_Pop(MemPool_t *pool);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void MemPool_Init(MemPool_t *pool, uint32_t *storage, uint32_t block_size, uint32_t num_blocks)
+{
+    assert_or_panic(storage != NULL && num_blocks > 0);
+    pool->storage = storage;
+    pool->block_words = MEMPOOL_BLOCK_WORDS(block_size);
+    pool->num_blocks = num_blocks;
+    pool->used_count = 0;
+    pool->peak_used_count = 0;
+
+    /* Link the blocks in address order, the last one points to NULL */
+    pool->free_list = NULL;
+    for (uint32_t idx = num_blocks; idx > 0; idx--)
+    {
+        uint32_t *block = &(storage[(idx - 1) * pool->block_words]);
+        *(void **)block = pool->free_list;
+        pool->free_list = block;
+    }
+    OS_Semaphore_Init(&(pool->free_blocks), (int32_t)num_blocks);
+}
+
+void *MemPool_Alloc(MemPool_t *pool)
+{
+    OS_Semaphore_Wait(&(pool->free_blocks));
+    return MemPool_Pop(pool);
+}
+
+HAL_StatusTypeDef MemPool_AllocTimeout(MemPool_t *pool, void **block, uint32_t timeout_ms)
+{
+    IFERR_RETE(OS_Semaphore_WaitTimeout(&(pool->free_blocks), timeout_ms));
+    *block = MemPool_Pop(pool);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef MemPool_TryAlloc(MemPool_t *pool, void **block)
+{
+    IFERR_RETE(OS_Semaphore_TryWait(&(pool->free_blocks)));
+    *block = MemPool_Pop(pool);
+    return HAL_OK;
+}
+
+void MemPool_Free(MemPool_t *pool, void *block)
+{
+    uint32_t *storage_end = &(pool->storage[pool->num_blocks * pool->block_words]);
+    assert_or_panic((uint32_t *)block >= pool->storage && (uint32_t *)block < storage_end);
+    assert_or_panic(((uint32_t *)block - pool->storage) % pool->block_words == 0);
+
+    OS_Critical_Enter();
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+    pool->used_count--;
+    OS_Critical_Exit();
+    OS_Semaphore_Signal(&(pool->free_blocks));
+}
+
+void MemPool_GetStats(MemPool_t *pool, MemPoolStats_t *stats)
+{
+    OS_Critical_Enter();
+    stats->used_count = pool->used_count;
+    stats->peak_used_count = pool->peak_used_count;
+    OS_Critical_Exit();
+    stats->num_blocks = pool->num_blocks;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static void *MemPool_Pop(MemPool_t *pool)
+{
+    OS_Critical_Enter();
+    void *block = pool->free_list;
+    pool->free_list = *(void **)block;
+    pool->used_count++;
+    if (pool->used_count > pool->peak_used_count)
+    {
+        pool->peak_used_count = pool->used_count;
+    }
+    OS_Critical_Exit();
+    return block;
+}
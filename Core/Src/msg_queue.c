@@ -0,0 +1,140 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "msg_queue.h"
+
+#include "iferr.h"
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+/**
+ * The fn MsgQueue_Slot returns the slot at idx: its first word is the message's length, the payload follows.
+ */
+static uint32_t *MsgQueue_Slot(MsgQueue_t *queue, uint32_t idx);
+
+/**
+ * The fn MsgQueue_NextIdx returns the index of the slot after idx, wrapping at the end of the storage.
+ */
+static uint32_t MsgQueue_NextIdx(MsgQueue_t *queue, uint32_t idx);
+
+/**
+ * The fn MsgQueue_GetRemainingMs returns how much of timeout_ms is left since start_tick, 0 if it's over.
+ */
+static uint32_t MsgQueue_GetRemainingMs(uint32_t start_tick, uint32_t timeout_ms);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void MsgQueue_Init(MsgQueue_t *queue, uint32_t *storage, uint32_t max_msg_size, uint32_t num_slots)
+{
+    assert_or_panic(storage != NULL && max_msg_size > 0 && num_slots > 0);
+    queue->storage = storage;
+    queue->max_msg_size = max_msg_size;
+    queue->slot_words = MSGQUEUE_SLOT_WORDS(max_msg_size);
+    queue->num_slots = num_slots;
+    queue->put_idx = queue->get_idx = 0;
+    OS_Semaphore_Init(&(queue->slots_used), 0);
+    OS_Semaphore_Init(&(queue->slots_free), (int32_t)num_slots);
+    OS_Mutex_Init(&(queue->put_mutex));
+    OS_Mutex_Init(&(queue->get_mutex));
+}
+
+void *MsgQueue_Reserve(MsgQueue_t *queue)
+{
+    OS_Semaphore_Wait(&(queue->slots_free));
+    OS_Mutex_Lock(&(queue->put_mutex));
+    return MsgQueue_Slot(queue, queue->put_idx) + 1;
+}
+
+HAL_StatusTypeDef MsgQueue_ReserveTimeout(MsgQueue_t *queue, void **payload, uint32_t timeout_ms)
+{
+    /* The timeout covers both waiting for a free slot and for the put side: if the put side can't be locked
+     * in time, the slot goes back to the semaphore */
+    uint32_t start_tick = HAL_GetTick();
+    IFERR_RETE(OS_Semaphore_WaitTimeout(&(queue->slots_free), timeout_ms));
+    if (OS_Mutex_LockTimeout(&(queue->put_mutex), MsgQueue_GetRemainingMs(start_tick, timeout_ms)) != HAL_OK)
+    {
+        OS_Semaphore_Signal(&(queue->slots_free));
+        return HAL_TIMEOUT;
+    }
+    *payload = MsgQueue_Slot(queue, queue->put_idx) + 1;
+    return HAL_OK;
+}
+
+void MsgQueue_Commit(MsgQueue_t *queue, uint32_t msg_size)
+{
+    assert_or_panic(msg_size <= queue->max_msg_size);
+    MsgQueue_Slot(queue, queue->put_idx)[0] = msg_size;
+    queue->put_idx = MsgQueue_NextIdx(queue, queue->put_idx);
+    OS_Mutex_Unlock(&(queue->put_mutex));
+    OS_Semaphore_Signal(&(queue->slots_used));
+}
+
+const void *MsgQueue_Receive(MsgQueue_t *queue, uint32_t *msg_size)
+{
+    OS_Semaphore_Wait(&(queue->slots_used));
+    OS_Mutex_Lock(&(queue->get_mutex));
+    uint32_t *slot = MsgQueue_Slot(queue, queue->get_idx);
+    *msg_size = slot[0];
+    return slot + 1;
+}
+
+HAL_StatusTypeDef MsgQueue_ReceiveTimeout(MsgQueue_t *queue, const void **payload, uint32_t *msg_size,
+                                          uint32_t timeout_ms)
+{
+    uint32_t start_tick = HAL_GetTick();
+    IFERR_RETE(OS_Semaphore_WaitTimeout(&(queue->slots_used), timeout_ms));
+    if (OS_Mutex_LockTimeout(&(queue->get_mutex), MsgQueue_GetRemainingMs(start_tick, timeout_ms)) != HAL_OK)
+    {
+        OS_Semaphore_Signal(&(queue->slots_used));
+        return HAL_TIMEOUT;
+    }
+    uint32_t *slot = MsgQueue_Slot(queue, queue->get_idx);
+    *msg_size = slot[0];
+    *payload = slot + 1;
+    return HAL_OK;
+}
+
+void MsgQueue_Release(MsgQueue_t *queue)
+{
+    queue->get_idx = MsgQueue_NextIdx(queue, queue->get_idx);
+    OS_Mutex_Unlock(&(queue->get_mutex));
+    OS_Semaphore_Signal(&(queue->slots_free));
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static uint32_t *MsgQueue_Slot(MsgQueue_t *queue, uint32_t idx)
+{
+    return &(queue->storage[idx * queue->slot_words]);
+}
+
+static uint32_t MsgQueue_NextIdx(MsgQueue_t *queue, uint32_t idx)
+{
+    idx++;
+    return (idx == queue->num_slots) ? 0 : idx;
+}
+
+static uint32_t MsgQueue_GetRemainingMs(uint32_t start_tick, uint32_t timeout_ms)
+{
+    uint32_t elapsed_ms = HAL_GetTick() - start_tick;
+    return (elapsed_ms < timeout_ms) ? (timeout_ms - elapsed_ms) : 0;
+}
@@ -29,7 +29,8 @@ static void OnTouch(void);
 // STATIC VARIABLES
 //==================================================================================================
 
-static Semaphore_t SemaphoreButtonPressed = 0;
+/* Handle of OnboardUserButton_Task, notified by the interrupt handler */
+static ThreadHandle_t ButtonTask;
 
 //==================================================================================================
 // GLOBAL FUNCTIONS
@@ -45,7 +46,6 @@ void OnboardUserButton_Init(void)
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
     HAL_NVIC_SetPriority(EXTI0_IRQn, 0x0F, 0); /* Minimum pre-emption priority */
-    HAL_NVIC_EnableIRQ(EXTI0_IRQn);
     InstrumentTriggerPE8_Init();
 }
 
@@ -53,14 +53,17 @@ void OnboardUserButton_IRQHandler(void)
 {
     __HAL_GPIO_EXTI_CLEAR_IT(GPIO_PIN_0);
     HAL_NVIC_DisableIRQ(EXTI0_IRQn);
-    OS_Semaphore_Signal(&SemaphoreButtonPressed);
+    OS_Thread_NotifyGive(ButtonTask);
 }
 
 void OnboardUserButton_Task(void)
 {
+    /* The interrupt is enabled only once the task is known, so that the handler can notify it */
+    ButtonTask = OS_Thread_GetCurrent();
+    HAL_NVIC_EnableIRQ(EXTI0_IRQn);
     while (1)
     {
-        OS_Semaphore_Wait(&SemaphoreButtonPressed);
+        OS_Thread_NotifyWait(UINT32_MAX);
         OnTouch();
         HAL_Delay(10);
         HAL_NVIC_EnableIRQ(EXTI0_IRQn);
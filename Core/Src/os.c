@@ -6,25 +6,75 @@
 
 #include "iferr.h"
 #include "schedl_timer.h"
+#include "tick_timer.h"
 
 #include "stm32f3xx_hal.h"
+#include <stdbool.h>
 
 //==================================================================================================
 // DEFINES - MACROS
 //==================================================================================================
 
+#define OS_NUMTCBS (MAXNUMTHREADS + 1) /* The TCB after the user threads' ones is reserved to the idle thread */
+#define OS_IDLE_TCB_IDX MAXNUMTHREADS
+
+#define OS_NUMPRIORITIES (OS_SCHEDL_PRIO_MIN + 1)   /* Number of priority levels, one ready list each */
+#define OS_PRIOBITMAP_WORDS (OS_NUMPRIORITIES / 32) /* Number of 32-bit words in the priority bitmap */
+
+/* Passed to OS_Thread_Block by the fns that wait until woken up, without a timeout */
+#define OS_NO_TIMEOUT 0
+
+/* EXC_RETURN value for returning to thread mode, on the process stack, without FP context */
+#define OS_EXC_RETURN_THREAD_PSP 0xFFFFFFFD
+
+/* PendSV has the lowest priority, so that the context switch never preempts an ISR */
+#define OS_PENDSV_PRIORITY ((1 << __NVIC_PRIO_BITS) - 1)
+
+/* With OS_USE_CCMRAM, the data and code used on every context switch are placed in CCM RAM */
+#if OS_USE_CCMRAM
+#define OS_HOT_DATA __attribute__((section(".ccmbss")))
+#define OS_HOT_CODE __attribute__((section(".ccmram.text")))
+#else
+#define OS_HOT_DATA
+#define OS_HOT_CODE
+#endif
+
+/* Stack sizes are rounded up so that each stack carved out of the pool keeps its alignment */
+#define OS_STACK_ROUNDUP(words) (((words) + (OS_STACK_ALIGN / 4) - 1) & ~((OS_STACK_ALIGN / 4) - 1U))
+
+/* With OS_STACK_OVERFLOW_CHECK_MPU, the lowest 8 words of the running thread's stack are covered by the
+ * guard region, the highest-numbered one so that it takes precedence over any other region */
+#if OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_MPU
+#define OS_STACK_GUARD_WORDS 8
+#else
+#define OS_STACK_GUARD_WORDS 0
+#endif
+#define OS_MPU_GUARD_REGION MPU_REGION_NUMBER7
+
+/* The ISRs calling kernel fns must be masked by the kernel critical sections */
+_Static_assert(OS_KERNEL_IRQ_PRIORITY > 0, "BASEPRI 0 doesn't mask any interrupt");
+_Static_assert(__NVIC_PRIO_BITS == 4, "OS_KERNEL_BASEPRI assumes 4 priority bits");
+_Static_assert(TICK_INT_PRIORITY >= OS_KERNEL_IRQ_PRIORITY, "the SysTick must be at or below the kernel ceiling");
+_Static_assert(SchedlTimer_IRQPreemptPriority >= OS_KERNEL_IRQ_PRIORITY,
+               "the SchedlTimer must be at or below the kernel ceiling");
+
+/* The priority bitmaps are stored MSB-first, so that CLZ returns the highest priority directly */
+#define OS_PRIOBITMAP_BIT(n) (0x80000000U >> ((n) & 0x1F))
+
 //==================================================================================================
 // ENUMS - STRUCTS - TYPEDEFS
 //==================================================================================================
 
 /**
- * TCBState indicates whether the TCB can be used by OS_ThreadCreate
- * to create a new thread.
+ * TCBState indicates whether the TCB can be used by OS_ThreadCreate to create a new thread,
+ * and, if not, which list the thread is part of.
  */
 typedef enum
 {
     TCBStateFree,
-    TCBStateActive
+    TCBStateReady,    /* In the ready lists, running or not */
+    TCBStateSleeping, /* In the timing wheel only */
+    TCBStateBlocked   /* In the wait list of a semaphore, mutex or event flags */
 } TCBState_t;
 
 /**
@@ -36,28 +86,81 @@ typedef enum
  */
 typedef struct TCB
 {
-    uint32_t *sp;         /* Stack pointer, valid for threads not running */
-    struct TCB *next;     /* Pointer to circular-linked-list of TCBs */
-    uint32_t sleep;       /* Sleep duration in ms, zero means not sleeping */
-    TCBState_t status;    /* TCB active or free */
-    Semaphore_t *blocked; /* Pointer to semaphore on which the thread is blocked, NULL if not blocked */
-    uint8_t priority;     /* Thread priority, 0 is highest, 255 is lowest */
-    const char *name;     /* Descriptive name to facilitate debugging */
+    uint32_t *sp;            /* Stack pointer, valid for threads not running */
+    struct TCB *next;        /* Next TCB in the circular ready list of the same priority, or in the wait list */
+    struct TCB *prev;        /* Previous TCB in the circular ready list of the same priority */
+    Timeout_t timeout;       /* Wake-up time of a sleeping thread, or timeout of a blocked one, if armed */
+    TCBState_t status;       /* TCB free, or list the thread is part of */
+    struct TCB **blocked;    /* Wait list of the kernel object the thread is blocked on, NULL if none */
+    uint8_t priority;        /* Thread priority, 0 is highest, 255 is lowest, possibly inherited through a mutex */
+    uint8_t base_priority;   /* Thread priority assigned at creation */
+    Mutex_t *held_mutexes;   /* Mutexes owned by the thread, most recently locked first */
+    Mutex_t *waited_mutex;   /* Mutex on which the thread is blocked, NULL if none */
+    Semaphore_t *waited_sem; /* Semaphore on which the thread is blocked, NULL if none */
+    uint32_t event_flags;    /* Flags waited for while blocked on event flags, then the ones that woke the thread up */
+    uint32_t event_options;  /* Options of the wait on event flags, OS_EVENTFLAGS_WAIT_ALL etc. */
+    uint32_t notify_value;   /* Notification value, updated by OS_Thread_Notify */
+    bool notify_pending;     /* Set by OS_Thread_Notify, cleared once the thread takes the notification */
+    bool notify_waiting;     /* Set while the thread is blocked in OS_Thread_NotifyWait */
+    bool timed_out;          /* Set if the thread's last timed wait expired before it was woken up */
+    uint32_t *stack_base;    /* Lowest address of the thread's stack, NULL if the TCB has no stack yet */
+    uint32_t stack_size;     /* Number of 32-bit words in the thread's stack */
+    bool stack_from_pool;    /* Set if the stack was carved out of the stack pool, it stays with the TCB once free */
+    const char *name;        /* Descriptive name to facilitate debugging */
 } TCB_t;
 
 //==================================================================================================
 // GLOBAL AND STATIC VARIABLES
 //==================================================================================================
 
-static TCB_t TCBs[MAXNUMTHREADS];
-static uint32_t Stacks[MAXNUMTHREADS][STACKSIZE];
+static TCB_t TCBs[OS_NUMTCBS] OS_HOT_DATA;
+
+/* Stacks carved out by OS_Thread_Create, placed in the linker's thread stacks region with the ones
+ * declared with OS_THREAD_STACK. StackPoolNext points to the first word not assigned to a thread yet */
+static uint32_t StackPool[OS_STACKPOOL_SIZE]
+    __attribute__((section(OS_THREAD_STACKS_SECTION), aligned(OS_STACK_ALIGN)));
+static uint32_t *StackPoolNext = StackPool;
 
 /* Pointer to the currently running thread */
-TCB_t *RunPt;
+TCB_t *RunPt OS_HOT_DATA;
+
+/* ReadyLists[p] points to the next thread to run among the ready threads of priority p, NULL if none */
+static TCB_t *ReadyLists[OS_NUMPRIORITIES] OS_HOT_DATA;
+
+/* Bit (31 - p % 32) of ReadyBitmap[p / 32] is set when ReadyLists[p] is not empty,
+ * bit (31 - w) of ReadyGroup is set when ReadyBitmap[w] is not zero */
+static uint32_t ReadyGroup OS_HOT_DATA;
+static uint32_t ReadyBitmap[OS_PRIOBITMAP_WORDS] OS_HOT_DATA;
+
+/* Timeouts holds the wake-up times of the sleeping threads and of the threads blocked with a timeout,
+ * and the timeouts armed with OS_Timeout_Start. The threads' ones have no callback */
+static TimingWheel_t Timeouts;
 
 /* The variable ActiveTCBsCount tracks the number of TCBs in use by the OS */
 static uint32_t ActiveTCBsCount;
 
+/* The variable IsRunning is set once OS_Launch is called, context switches can't be requested before */
+static bool IsRunning;
+
+/* Fns registered with OS_Idle_AddHook, run by the idle thread */
+static void (*IdleHooks[OS_MAXNUMIDLEHOOKS])(void);
+static uint32_t IdleHooksCount;
+
+/* Cycles the idle thread spent sleeping, since the current CPU load period started */
+static uint32_t IdleCycles;
+
+/* HAL tick and DWT cycle count when the current CPU load period started */
+static uint32_t LoadPeriodStartTick;
+static uint32_t LoadPeriodStartCycles;
+
+/* Busy cycles and duration of the last OS_CPULOAD_WINDOW periods, LoadIdx is the oldest one */
+static uint32_t LoadBusyCycles[OS_CPULOAD_WINDOW];
+static uint32_t LoadPeriodDurationMs[OS_CPULOAD_WINDOW];
+static uint32_t LoadIdx;
+
+/* Name of the thread whose stack overflowed, for inspection with the debugger after the panic or fault */
+static const char *volatile OverflowedThreadName __USED;
+
 //==================================================================================================
 // FUNCTION PROTOTYPES
 //==================================================================================================
@@ -68,95 +171,460 @@ static uint32_t ActiveTCBsCount;
 static void OS_InitTCBsStatus(void);
 
 /**
- * The fn OS_Init initializes the SchedlTimer and the TCBs.
+ * The fn OS_ReadyList_Insert appends the TCB to the ready list of its priority.
+ * The fn OS_ReadyList_Remove unlinks the TCB from the ready list of its priority.
+ * The fn OS_ReadyList_GetHighest returns the next TCB to run among those with the highest
+ * priority, NULL if no thread is ready. It runs in constant time, thanks to the CLZ instruction.
+ *
+ * Sleeping, blocked and killed threads are never part of the ready lists.
+ * The fns must be called in a critical section.
+ */
+static void OS_ReadyList_Insert(TCB_t *tcb);
+static void OS_ReadyList_Remove(TCB_t *tcb);
+static TCB_t *OS_ReadyList_GetHighest(void);
+
+/**
+ * The fn OS_MakeReady adds the TCB to the ready lists and, if its priority is higher than the
+ * running thread's, requests a context switch, so that the thread preempts the running one right away.
+ * It's used by every kernel fn that readies a thread, both in thread and ISR context.
+ * The fn must be called in a critical section.
+ */
+static void OS_MakeReady(TCB_t *tcb);
+
+/**
+ * The fn OS_IdleThread is run when no other thread is ready, it has the lowest priority and
+ * can't be killed. It runs the idle hooks, then, if it's still the only ready thread, calls OS_Idle.
+ */
+static void OS_IdleThread(void);
+
+/**
+ * The fn OS_Idle is called by the idle thread, and puts the CPU to sleep until an interrupt occurs.
+ * The pending ISRs are then run, and might wake up a thread.
+ * The cycles spent sleeping are accounted as idle for the CPU load measurement.
+ *
+ * If OS_TICKLESS_IDLE is enabled, the periodic tick and the SchedlTimer are suppressed while
+ * sleeping, and the SysTick is programmed to interrupt only when the first sleeping thread has to
+ * be woken up, or the timing wheel has to cascade. On wake-up, the timing wheel is advanced by the ticks
+ * that elapsed in the meantime.
+ *
+ * The fn must be called in a critical section.
+ */
+static void OS_Idle(void);
+
+/**
+ * The fn OS_WaitForInterrupt puts the CPU to sleep until an interrupt is pending, and returns in a critical section.
+ * Interrupts masked by BASEPRI don't wake up the CPU, so they're masked with PRIMASK instead while sleeping:
+ * the ones above the kernel ceiling are taken right after wake-up, the others once the critical section is exited.
+ * The fn must be called in a critical section.
+ */
+static void OS_WaitForInterrupt(void);
+
+/**
+ * The fn OS_CPULoad_Update is called on every tick and, once OS_CPULOAD_PERIOD_MS have passed,
+ * stores the busy cycles of the period in the sliding window used by OS_CPULoad_Get.
+ *
+ * Busy cycles are those counted by the DWT cycle counter minus the ones the idle thread spent
+ * sleeping: that's correct whether or not the counter keeps running while the CPU sleeps.
+ * The fn must be called in a critical section.
+ */
+static void OS_CPULoad_Update(void);
+
+/**
+ * The fn OS_Stack_CheckOverflow is called by OS_Scheduler for the thread being switched out, with
+ * OS_STACK_OVERFLOW_CHECK_CANARY. It panics if the thread's saved SP is below its stack, or if
+ * the lowest word of its stack (the canary) has been overwritten, recording the thread's name in
+ * OverflowedThreadName first.
+ * The overflow is only detected after it happened, so the memory below the stack might be corrupted already.
+ *
+ * With OS_STACK_OVERFLOW_CHECK_MPU instead, the fn OS_Stack_InitGuard configures the MPU guard region
+ * and enables the MemManage fault, and the fn OS_Stack_MoveGuard moves the region over the lowest
+ * 32 bytes of the TCB's stack. OS_Scheduler calls it for the thread switched in, at the cost of a single store.
+ * The privileged default memory map applies everywhere else.
+ */
+#if OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_CANARY
+static void OS_Stack_CheckOverflow(TCB_t *tcb);
+#elif OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_MPU
+static void OS_Stack_InitGuard(void);
+static void OS_Stack_MoveGuard(TCB_t *tcb);
+#endif
+
+/**
+ * The fn OS_Init initializes the SchedlTimer, the DWT cycle counter and the TCBs, then creates the idle thread.
+ * With OS_STACK_OVERFLOW_CHECK_MPU, it enables the MPU with the stack guard region too.
  */
 void OS_Init(uint32_t scheduler_frequency_hz);
 
 /**
- * The fn OS_SetInitialStack sets up the thread's stack as if it had already been running and then suspended.
+ * The fn OS_SetInitialStack fills the thread's stack with OS_STACK_PAINT, then sets it up as if the
+ * thread had already been running and then suspended.
  * Finally, it sets the TCB's SP (stack pointer) to the top of the stack (grows downwards).
  * Check the "STM32 Cortex-M4 Programming Manual" on page 18 for the list of processor core registers.
+ *
+ * Besides the registers, the fn OSAsm_ThreadSwitch saves the EXC_RETURN value of each thread, which
+ * tells whether the thread has used the FPU, and so whether S16-S31 are saved too.
+ * A new thread starts without FP context.
  */
 static void OS_SetInitialStack(uint32_t tcb_idx);
 
 /**
- * The fn OS_Thread_CreateFirst establishes the circular linked list of TCBs with one node,
- * and points RunPt to that node. The fn must be called before the OS is launched.
+ * The fn OS_InitTCB marks the TCB as active, and sets up its stack so that the thread starts from task.
+ * The TCB's stack must have already been assigned.
+ */
+static void OS_InitTCB(uint32_t tcb_idx, void (*task)(void), uint8_t priority, const char *name);
+
+/**
+ * The fn OS_StackPool_Assign gives the TCB a stack of stack_size words from the stack pool, reusing the
+ * one it already has if it's large enough. It fails if the pool is exhausted.
+ * The fn OS_FindFreeTCB returns the index of a free TCB for a stack of stack_size words: preferably one
+ * whose pool stack can be reused with the least waste, otherwise one with no stack yet, otherwise any free
+ * one, whose pool stack is too small and is then left unused. It fails if all the TCBs are already active.
+ */
+static void OS_StackPool_Assign(uint32_t tcb_idx, uint32_t stack_size);
+static uint32_t OS_FindFreeTCB(uint32_t stack_size);
+
+/**
+ * The fn OS_Thread_CreateFirst adds the first thread to the ready lists and points RunPt to it.
+ * The fn must be called before the OS is launched.
  */
-void OS_Thread_CreateFirst(void (*task)(void), uint8_t priority, const char *name);
+ThreadHandle_t OS_Thread_CreateFirst(void (*task)(void), uint8_t priority, const char *name, uint32_t stack_size);
 
 /**
- * The fn OS_Thread_Create adds a new thread to the circular linked list of TCBs, then runs it.
- * It fails if all the TCBs are already active.
+ * The fn OS_Thread_Create adds a new thread, with a stack of stack_size 32-bit words, to the ready lists.
+ * The stack is carved out of the linker's thread stacks region, or reused from a killed thread.
+ * It fails if all the TCBs are already active, or if the stack pool is exhausted.
+ *
+ * The fn OS_Thread_CreateWithStack behaves the same, but the thread runs on a stack provided by the
+ * caller, preferably declared with OS_THREAD_STACK so that it's placed in the thread stacks region.
+ * It takes a TCB that has no pool stack, that is, one that has never run a thread created by OS_Thread_Create,
+ * and fails if there's none left.
  *
- * The fn can be called both:
+ * The fns can be called both:
  *   - before the OS is launched (but after the first thread is created);
  *   - after the OS is launched (by a running thread).
  *
- * The thread that calls this function keeps running until the end of its scheduled time-slice.
- * The new thread is run next.
+ * If the new thread has a higher priority than the calling one, it's run immediately, otherwise
+ * the thread that calls this function keeps running until the end of its scheduled time-slice.
+ *
+ * The fns return the new thread's handle, which stays valid until the thread is killed.
+ * The fn OS_Thread_GetCurrent returns the handle of the calling thread.
  */
-void OS_Thread_Create(void (*task)(void), uint8_t priority, const char *name);
+ThreadHandle_t OS_Thread_Create(void (*task)(void), uint8_t priority, const char *name, uint32_t stack_size);
+ThreadHandle_t OS_Thread_CreateWithStack(void (*task)(void), uint8_t priority, const char *name, uint32_t *stack,
+                                         uint32_t stack_size);
+ThreadHandle_t OS_Thread_GetCurrent(void);
 
 /**
- * The fn OS_Launch enables the SchedlTimer, then calls OSAsm_Start, which launches the first thread.
+ * The fn OS_Launch assigns the lowest priority to the PendSV exception, enables the SchedlTimer,
+ * then calls OSAsm_Start, which launches the ready thread with the highest priority.
  */
 void OS_Launch(void);
 
 /**
  * The fn OSAsm_Start, implemented in os_asm.s, is called by OS_Launch once.
- * It "restores" the first thread's stack on the main stack.
+ * It resets the main stack, which from then on is used by the ISRs only, and "restores" the first
+ * thread's stack on the process stack.
  */
 extern void OSAsm_Start(void);
 
 /**
- * The fn OSAsm_ThreadSwitch, implemented in os_asm.s, is periodically called by the SchedlTimer (ISR).
- * It preemptively switches to the next thread, that is, it stores the stack of the running
- * thread and restores the stack of the next thread.
+ * The fn OSAsm_ThreadSwitch, implemented in os_asm.s, is the PendSV exception handler.
+ * It switches to the next thread, that is, it stores the stack of the running thread and
+ * restores the stack of the next thread.
  * It calls OS_Schedule to determine which thread is run next and update RunPt.
+ *
+ * As PendSV has the lowest priority, the switch is performed only after all the other ISRs
+ * have completed, and always returns to thread mode.
  */
 extern void OSAsm_ThreadSwitch(void);
 
+/**
+ * The fn OS_IsRunning returns whether the OS has been launched, that is, whether threads are being scheduled.
+ */
+bool OS_IsRunning(void);
+
+/**
+ * The fn OS_Scheduler_Invoke pends the PendSV exception, that is, it requests a context switch.
+ * It can be called both by threads and by ISRs: in a critical section, the switch is
+ * performed as soon as they're enabled again.
+ * The SchedlTimer's ISR calls it when the running thread's time-slice expires.
+ */
+void OS_Scheduler_Invoke(void);
+
 /**
  * The fn OS_Scheduler is called by OSAsm_ThreadSwitch and is responsible for determining
- * which thread is run next.
+ * which thread is run next: the first ready thread with the highest priority.
+ * If the running thread is still the one to run, that is, it yielded or its time-slice expired,
+ * it's moved at the back of its ready list, so that threads with the same priority are run in
+ * round-robin fashion. A thread preempted by a higher priority one stays at the front instead.
  */
 void OS_Scheduler(void);
 
 /**
  * The fn OS_Thread_Suspend halts the current thread and switches to the next.
- * It's called by the running thread itself.
+ * It's called by the running thread itself, and returns when the thread is scheduled again.
  */
 void OS_Thread_Suspend(void);
 
 /**
  * The fn OS_Thread_Sleep makes the current thread dormant for a specified time.
  * It's called by the running thread itself.
- * The fn OS_DecrementTCBsSleepDuration is called by the SysTick ISR every ms and decrements the
- * the value of sleep on the TCBs.
+ * The fn OS_Tick is called by the SysTick ISR every ms and advances the timing wheel, moving the threads
+ * whose sleep or wait timeout expired straight to the ready lists, then running the callbacks of the expired
+ * timeouts armed with OS_Timeout_Start, outside the critical section.
+ * Its cost doesn't depend on the number of threads or timeouts, except for the ones expiring.
  */
 void OS_Thread_Sleep(uint32_t ms);
-void OS_DecrementTCBsSleepDuration(void);
+void OS_Tick(void);
 
 /**
  * The fn OS_Thread_Kill kills the thread that calls it, then starts the thread scheduled next.
- * It fails if the last active thread tries to kill itself.
  */
 void OS_Thread_Kill(void);
 
+/**
+ * The fn OS_Thread_Notify updates the thread's notification value as told by action, marks the notification
+ * as pending and, if the thread is waiting for it, wakes it up. The fn OS_Thread_NotifyGive is a shorthand
+ * for NotifyActionIncrement. They can be called both by threads and by ISRs.
+ *
+ * Every thread has its own notification value, so no kernel object is needed, and waking up a thread
+ * takes constant time: it's the cheapest way for an ISR to hand an event over to a known thread.
+ */
+void OS_Thread_Notify(ThreadHandle_t thread, NotifyAction_t action, uint32_t value);
+void OS_Thread_NotifyGive(ThreadHandle_t thread);
+
+/**
+ * The fn OS_Thread_NotifyWait blocks the calling thread until a notification is pending, then takes it:
+ * it clears the bits in clear_on_exit from the notification value, and returns the value as it was before.
+ * With clear_on_exit set to UINT32_MAX and OS_Thread_NotifyGive, it behaves like a counting semaphore
+ * that hands over all its units at once.
+ *
+ * The fn OS_Thread_NotifyWaitTimeout behaves the same, but gives up after timeout_ms: it returns HAL_OK
+ * and the value in value if a notification was taken, HAL_TIMEOUT otherwise.
+ */
+uint32_t OS_Thread_NotifyWait(uint32_t clear_on_exit);
+HAL_StatusTypeDef OS_Thread_NotifyWaitTimeout(uint32_t clear_on_exit, uint32_t *value, uint32_t timeout_ms);
+
+/**
+ * The fn OS_Timeout_Init sets the timeout up to run callback with arg when it expires.
+ * The fn OS_Timeout_Start arms it to expire after timeout_ms, restarting it if it's armed already, and
+ * the fn OS_Timeout_Cancel disarms it, if armed. The fn OS_Timeout_IsActive returns whether it's armed.
+ * They can be called both by threads and by ISRs, and take constant time however many timeouts are armed,
+ * so that protocol stacks can keep one per connection or per packet in flight.
+ *
+ * The callbacks are run by OS_Tick in the SysTick ISR, outside the critical section: they must be short,
+ * and can only call the kernel fns that ISRs can call, such as OS_Thread_Notify, or OS_Timeout_Start to
+ * re-arm the timeout. Longer jobs should be handed over to a thread, or to a SoftTimer.
+ */
+void OS_Timeout_Init(Timeout_t *timeout, void (*callback)(void *arg), void *arg);
+void OS_Timeout_Start(Timeout_t *timeout, uint32_t timeout_ms);
+void OS_Timeout_Cancel(Timeout_t *timeout);
+bool OS_Timeout_IsActive(Timeout_t *timeout);
+
+/**
+ * The fn OS_WaitList_Insert adds the TCB to a wait list, after the TCBs with higher or equal
+ * priority, so that the highest priority thread is woken up first, and threads with the same
+ * priority are woken up in the order they blocked.
+ * The fn OS_WaitList_PopFirst removes and returns the first TCB of a non-empty wait list.
+ *
+ * Wait lists are singly-linked through the TCB's next field, which is unused while the thread
+ * is not ready. The fns must be called in a critical section.
+ */
+static void OS_WaitList_Insert(TCB_t **wait_list, TCB_t *tcb);
+static TCB_t *OS_WaitList_PopFirst(TCB_t **wait_list);
+static void OS_WaitList_Remove(TCB_t *tcb);
+
+/**
+ * The fn OS_Thread_Block moves the running thread from the ready lists to the wait list, if any (a thread
+ * waiting for a notification isn't part of a wait list), and requests a context switch.
+ * If timeout_ms isn't OS_NO_TIMEOUT, the thread's timeout is armed too, and OS_Tick wakes it up
+ * with the timed_out flag set, unless it's woken up first.
+ * The fn OS_Thread_ExpireWait is called by OS_Tick when the timeout expires: it removes the TCB
+ * from the wait list and undoes its effects on the semaphore or mutex.
+ *
+ * The fns must be called in a critical section.
+ */
+static void OS_Thread_Block(TCB_t **wait_list, uint32_t timeout_ms);
+static void OS_Thread_ExpireWait(TCB_t *tcb);
+
+/**
+ * The fn OS_SetPriority changes the TCB's effective priority, and moves the TCB to the right
+ * place in the ready lists or in its wait list.
+ * If the running thread has been lowered, or a ready thread raised above it, a context switch is requested.
+ * The fn must be called in a critical section.
+ */
+static void OS_SetPriority(TCB_t *tcb, uint8_t priority);
+
+/**
+ * The fn OS_Mutex_GetInheritedPriority returns the priority the TCB should run at: the highest
+ * among its base priority and the priorities of the threads blocked on the mutexes it owns.
+ *
+ * The fn OS_Mutex_PropagatePriority recomputes the priority of the mutex's owner and, if the owner
+ * is in turn blocked on another mutex, of that mutex's owner, and so on (transitive inheritance).
+ * The chain is at most as long as the number of threads.
+ *
+ * The fns must be called in a critical section.
+ */
+static uint8_t OS_Mutex_GetInheritedPriority(TCB_t *tcb);
+static void OS_Mutex_PropagatePriority(Mutex_t *mutex);
+
+/**
+ * The fn OS_Idle_AddHook registers a fn to be run by the idle thread, every time it's scheduled.
+ * Idle hooks must never block. It fails if OS_MAXNUMIDLEHOOKS hooks are already registered.
+ */
+void OS_Idle_AddHook(void (*hook)(void));
+
+/**
+ * The fn OS_CPULoad_Get returns the CPU load, in percent, over the last
+ * OS_CPULOAD_WINDOW * OS_CPULOAD_PERIOD_MS ms.
+ */
+uint32_t OS_CPULoad_Get(void);
+
+/**
+ * The fn OS_Stack_GetUsage fills usages with the stack usage of up to max_count active threads,
+ * the idle thread included, and returns how many it filled.
+ * The words used are counted from the bottom of each stack up to the first one that doesn't hold
+ * OS_STACK_PAINT anymore, so the cost is proportional to the unused part of the stacks.
+ * The words covered by the MPU guard region are never read, and are accounted as unused.
+ */
+uint32_t OS_Stack_GetUsage(StackUsage_t *usages, uint32_t max_count);
+
+/**
+ * The fn OS_Stack_RecordOverflow is called by the MemManage fault handler with OS_STACK_OVERFLOW_CHECK_MPU,
+ * and records the name of the running thread, whose stack hit the guard region, in OverflowedThreadName.
+ */
+void OS_Stack_RecordOverflow(void);
+
+/**
+ * The fn OS_Mutex_Init sets the mutex as free, with no thread blocked on it.
+ */
+void OS_Mutex_Init(Mutex_t *mutex);
+
+/**
+ * The fn OS_Mutex_Lock takes ownership of the mutex.
+ * If the mutex is already owned by the calling thread, it increments the lock count (recursive lock).
+ * If the mutex is owned by another thread, the calling thread is blocked and, if it has a higher
+ * priority than the owner, the owner inherits its priority until it unlocks the mutex.
+ * It must not be called by ISRs.
+ */
+void OS_Mutex_Lock(Mutex_t *mutex);
+
+/**
+ * The fn OS_Mutex_Unlock decrements the lock count and, once it reaches zero, hands the mutex over
+ * to the first thread in its wait list. The calling thread drops the priority it inherited through the mutex.
+ * It fails if the calling thread isn't the owner.
+ */
+void OS_Mutex_Unlock(Mutex_t *mutex);
+
+/**
+ * The fn OS_Mutex_LockTimeout behaves like OS_Mutex_Lock, but gives up after timeout_ms.
+ * It returns HAL_OK if the mutex was taken, HAL_TIMEOUT otherwise.
+ * The fn OS_Mutex_TryLock never blocks: it returns HAL_OK if the mutex was taken, HAL_BUSY otherwise.
+ */
+HAL_StatusTypeDef OS_Mutex_LockTimeout(Mutex_t *mutex, uint32_t timeout_ms);
+HAL_StatusTypeDef OS_Mutex_TryLock(Mutex_t *mutex);
+
+/**
+ * The fn OS_Semaphore_TryDecrement decrements the semaphore counter if it's positive, and the fn
+ * OS_Semaphore_TryIncrement increments it if no thread is blocked on it. They return whether they did.
+ *
+ * They use exclusive loads and stores (LDREX/STREX) instead of a critical section, and are the fast path of
+ * the semaphore fns, which enter the kernel only when a thread has to be blocked or woken up.
+ * The counter is otherwise only updated in critical sections, which can't be interleaved with the fast path
+ * on a single core: if an ISR preempts the fast path between LDREX and STREX, the exception clears the
+ * exclusive monitor, the STREX fails, and the counter is read again.
+ */
+static bool OS_Semaphore_TryDecrement(Semaphore_t *sem);
+static bool OS_Semaphore_TryIncrement(Semaphore_t *sem);
+
+/**
+ * The fn OS_Semaphore_Init sets the semaphore's initial counter, with no thread blocked on it.
+ */
+void OS_Semaphore_Init(Semaphore_t *sem, int32_t initial_counter);
+
 /**
  * The fn OS_Semaphore_Wait decrements the semaphore counter.
- * If the new counter's value is < 0, it marks the current thread as blocked and switches
- * to the next one.
+ * If the new counter's value is < 0, it moves the current thread from the ready lists to the
+ * semaphore's wait list and switches to the next one.
+ * While the counter is positive, it takes the fast path and never enters a critical section.
  */
 void OS_Semaphore_Wait(Semaphore_t *sem);
 
+/**
+ * The fn OS_Semaphore_WaitTimeout behaves like OS_Semaphore_Wait, but gives up after timeout_ms.
+ * It returns HAL_OK if the semaphore was taken, HAL_TIMEOUT otherwise.
+ * The fn OS_Semaphore_TryWait never blocks: it returns HAL_OK if the semaphore was taken, HAL_BUSY otherwise.
+ * On the fast path, when the counter is positive, they cost as much as OS_Semaphore_Wait.
+ * The fn OS_Semaphore_TryWait can be called by ISRs too.
+ */
+HAL_StatusTypeDef OS_Semaphore_WaitTimeout(Semaphore_t *sem, uint32_t timeout_ms);
+HAL_StatusTypeDef OS_Semaphore_TryWait(Semaphore_t *sem);
+
+/**
+ * The fn OS_Semaphore_WaitUpTo decrements the semaphore counter by as much as it can, up to max_count,
+ * and returns by how much. If the counter isn't positive, it blocks until the semaphore is signaled once,
+ * then takes whatever has been signaled meanwhile. It always returns at least 1.
+ */
+uint32_t OS_Semaphore_WaitUpTo(Semaphore_t *sem, uint32_t max_count);
+
 /**
  * The fn OS_Semaphore_Signal increments the semaphore counter.
- * If the new counter's value is <= 0, it wakes up the next thread blocked on that semaphore.
+ * If the new counter's value is <= 0, it wakes up the first thread in the semaphore's wait list,
+ * which preempts the running thread immediately if it has a higher priority.
+ * While no thread is blocked on the semaphore, it takes the fast path and never enters a critical section.
+ * It can be called both by threads and by ISRs.
  */
 void OS_Semaphore_Signal(Semaphore_t *sem);
 
+/**
+ * The fn OS_Semaphore_SignalN increments the semaphore counter by count, waking up as many
+ * threads as needed, in a single critical section.
+ * It can be called both by threads and by ISRs.
+ */
+void OS_Semaphore_SignalN(Semaphore_t *sem, uint32_t count);
+
+/**
+ * The fn OS_EventFlags_Init clears all the flags, with no thread blocked on them.
+ */
+void OS_EventFlags_Init(EventFlags_t *event_flags);
+
+/**
+ * The fn OS_EventFlags_Set sets the flags, then wakes up, in priority order, all the blocked threads whose
+ * wait is satisfied. They all see the flags as they were set: those to be cleared on exit are cleared
+ * once the whole wait list has been evaluated.
+ * The wait list is walked only if the flags set are among the ones the blocked threads wait for.
+ * The fn OS_EventFlags_Clear clears the flags, and the fn OS_EventFlags_Get returns the flags currently set.
+ * They can be called both by threads and by ISRs.
+ */
+void OS_EventFlags_Set(EventFlags_t *event_flags, uint32_t flags);
+void OS_EventFlags_Clear(EventFlags_t *event_flags, uint32_t flags);
+uint32_t OS_EventFlags_Get(EventFlags_t *event_flags);
+
+/**
+ * The fn OS_EventFlags_Wait blocks the calling thread until any of the flags is set (OS_EVENTFLAGS_WAIT_ANY),
+ * or all of them (OS_EVENTFLAGS_WAIT_ALL), and returns the flags, among the ones waited for, that were set.
+ * With OS_EVENTFLAGS_CLEAR_ON_EXIT, the flags waited for are cleared before the fn returns.
+ *
+ * The fn OS_EventFlags_WaitTimeout behaves the same, but gives up after timeout_ms: it returns HAL_OK
+ * and the flags in matched_flags if the wait was satisfied, HAL_TIMEOUT otherwise.
+ * The fn OS_EventFlags_TryWait never blocks: it returns HAL_OK if the wait was satisfied, HAL_BUSY otherwise,
+ * and can be called by ISRs too.
+ */
+uint32_t OS_EventFlags_Wait(EventFlags_t *event_flags, uint32_t flags, uint32_t options);
+HAL_StatusTypeDef OS_EventFlags_WaitTimeout(EventFlags_t *event_flags, uint32_t flags, uint32_t options,
+                                            uint32_t *matched_flags, uint32_t timeout_ms);
+HAL_StatusTypeDef OS_EventFlags_TryWait(EventFlags_t *event_flags, uint32_t flags, uint32_t options,
+                                        uint32_t *matched_flags);
+
+/**
+ * The fn OS_EventFlags_IsSatisfied returns whether a wait for the flags, with the given options, is satisfied.
+ * The fn OS_EventFlags_TryTake returns false if the wait isn't satisfied, otherwise it stores the matched
+ * flags, clears them if requested, and returns true.
+ * The fn OS_EventFlags_TryTake must be called in a critical section.
+ */
+static bool OS_EventFlags_IsSatisfied(uint32_t flags_set, uint32_t flags, uint32_t options);
+static bool OS_EventFlags_TryTake(EventFlags_t *event_flags, uint32_t flags, uint32_t options,
+                                  uint32_t *matched_flags);
+
 //==================================================================================================
 // IMPLEMENTATION
 //==================================================================================================
@@ -169,189 +637,1222 @@ static void OS_InitTCBsStatus(void)
     }
 }
 
-void OS_Init(uint32_t scheduler_frequency_hz)
+static void OS_ReadyList_Insert(TCB_t *tcb)
 {
-    SchedlTimer_Init(scheduler_frequency_hz);
-    OS_InitTCBsStatus();
+    uint8_t priority = tcb->priority;
+    TCB_t *head = ReadyLists[priority];
+    if (head == NULL)
+    {
+        tcb->next = tcb;
+        tcb->prev = tcb;
+        ReadyLists[priority] = tcb;
+        ReadyBitmap[priority / 32] |= OS_PRIOBITMAP_BIT(priority);
+        ReadyGroup |= OS_PRIOBITMAP_BIT(priority / 32);
+        return;
+    }
+
+    /* The head is the next thread to run, so the tail is the one right before it */
+    tcb->next = head;
+    tcb->prev = head->prev;
+    head->prev->next = tcb;
+    head->prev = tcb;
 }
 
-static void OS_SetInitialStack(uint32_t tcb_idx)
-{
-    /* From the "STM32 Cortex-M4 Programming Manual" on page 23:
-     * attempting to execute instructions when  the T bit is 0 results in a fault or lockup */
-    Stacks[tcb_idx][STACKSIZE - 1] = 0x01000000; /* Thumb Bit (PSR) */
-    // Stacks[tcb_idx][STACKSIZE - 2] =           /* R15 (PC) -> set later in fn OS_AddThreads
-    Stacks[tcb_idx][STACKSIZE - 3] = 0x14141414;  /* R14 (LR) */
-    Stacks[tcb_idx][STACKSIZE - 4] = 0x12121212;  /* R12 */
-    Stacks[tcb_idx][STACKSIZE - 5] = 0x03030303;  /* R3 */
-    Stacks[tcb_idx][STACKSIZE - 6] = 0x02020202;  /* R2 */
-    Stacks[tcb_idx][STACKSIZE - 7] = 0x01010101;  /* R1 */
-    Stacks[tcb_idx][STACKSIZE - 8] = 0x00000000;  /* R0 */
-    Stacks[tcb_idx][STACKSIZE - 9] = 0x11111111;  /* R11 */
-    Stacks[tcb_idx][STACKSIZE - 10] = 0x10101010; /* R10 */
-    Stacks[tcb_idx][STACKSIZE - 11] = 0x09090909; /* R9 */
-    Stacks[tcb_idx][STACKSIZE - 12] = 0x08080808; /* R8 */
-    Stacks[tcb_idx][STACKSIZE - 13] = 0x07070707; /* R7 */
-    Stacks[tcb_idx][STACKSIZE - 14] = 0x06060606; /* R6 */
-    Stacks[tcb_idx][STACKSIZE - 15] = 0x05050505; /* R5 */
-    Stacks[tcb_idx][STACKSIZE - 16] = 0x04040404; /* R4 */
-
-    TCBs[tcb_idx].sp = &Stacks[tcb_idx][STACKSIZE - 16]; /* Thread's stack pointer */
-}
-
-void OS_Thread_CreateFirst(void (*task)(void), uint8_t priority, const char *name)
+static void OS_ReadyList_Remove(TCB_t *tcb)
 {
-    assert_or_panic(ActiveTCBsCount == 0);
-    TCBs[0].next = &(TCBs[0]);
-    TCBs[0].sleep = 0;
-    TCBs[0].status = TCBStateActive;
-    TCBs[0].blocked = NULL;
-    TCBs[0].priority = priority;
-    TCBs[0].name = name;
-
-    OS_SetInitialStack(0);
-    Stacks[0][STACKSIZE - 2] = (int32_t)task; /* PC */
+    uint8_t priority = tcb->priority;
+    if (tcb->next == tcb)
+    {
+        ReadyLists[priority] = NULL;
+        ReadyBitmap[priority / 32] &= ~OS_PRIOBITMAP_BIT(priority);
+        if (ReadyBitmap[priority / 32] == 0)
+        {
+            ReadyGroup &= ~OS_PRIOBITMAP_BIT(priority / 32);
+        }
+        return;
+    }
 
-    /* Thread 0 will run first */
-    RunPt = &(TCBs[0]);
-    ActiveTCBsCount++;
+    tcb->prev->next = tcb->next;
+    tcb->next->prev = tcb->prev;
+    if (ReadyLists[priority] == tcb)
+    {
+        ReadyLists[priority] = tcb->next;
+    }
 }
 
-void OS_Thread_Create(void (*task)(void), uint8_t priority, const char *name)
+OS_HOT_CODE static TCB_t *OS_ReadyList_GetHighest(void)
 {
-    assert_or_panic(ActiveTCBsCount > 0 && ActiveTCBsCount < MAXNUMTHREADS);
-    __disable_irq();
-
-    /* Find next available TCB */
-    uint32_t new_tcb_idx;
-    for (new_tcb_idx = 0; new_tcb_idx < MAXNUMTHREADS; new_tcb_idx++)
+    if (ReadyGroup == 0)
     {
-        if (TCBs[new_tcb_idx].status == TCBStateFree)
-            break;
+        return NULL;
     }
+    uint32_t word_idx = __CLZ(ReadyGroup);
+    uint32_t bit_idx = __CLZ(ReadyBitmap[word_idx]);
+    return ReadyLists[word_idx * 32 + bit_idx];
+}
 
-    TCBs[new_tcb_idx].next = RunPt->next;
-    RunPt->next = &(TCBs[new_tcb_idx]);
-    TCBs[new_tcb_idx].sleep = 0;
-    TCBs[new_tcb_idx].status = TCBStateActive;
-    TCBs[new_tcb_idx].blocked = NULL;
-    TCBs[new_tcb_idx].priority = priority;
-    TCBs[new_tcb_idx].name = name;
+static void OS_MakeReady(TCB_t *tcb)
+{
+    /* A thread woken up before its timeout expired still has it armed */
+    if (TimingWheel_IsArmed(&(tcb->timeout)))
+    {
+        TimingWheel_Remove(&Timeouts, &(tcb->timeout));
+    }
+    tcb->status = TCBStateReady;
+    OS_ReadyList_Insert(tcb);
+    if (IsRunning && tcb->priority < RunPt->priority)
+    {
+        OS_Scheduler_Invoke();
+    }
+}
 
-    OS_SetInitialStack(new_tcb_idx);
-    Stacks[new_tcb_idx][STACKSIZE - 2] = (int32_t)task; /* PC */
+static void OS_IdleThread(void)
+{
+    while (1)
+    {
+        for (uint32_t hook_idx = 0; hook_idx < IdleHooksCount; hook_idx++)
+        {
+            IdleHooks[hook_idx]();
+        }
 
-    ActiveTCBsCount++;
-    __enable_irq();
+        /* Threads with the lowest priority might be sharing the CPU with the idle thread */
+        OS_Critical_Enter();
+        TCB_t *idle_tcb = &(TCBs[OS_IDLE_TCB_IDX]);
+        if ((OS_ReadyList_GetHighest() == idle_tcb) && (idle_tcb->next == idle_tcb))
+        {
+            OS_Idle();
+        }
+        OS_Critical_Exit();
+    }
 }
 
-void OS_Launch(void)
+static void OS_Idle(void)
 {
-    assert_or_panic(ActiveTCBsCount > 0);
+    uint32_t sleep_start_cycles = DWT->CYCCNT;
 
-    /* Prevent the timer's ISR from firing before OSAsm_Start is called */
-    __disable_irq();
+#if OS_TICKLESS_IDLE
+    uint32_t idle_ms = TimingWheel_GetIdleTicks(&Timeouts);
+    if ((idle_ms >= OS_TICKLESS_MIN_IDLE_MS) && TickTimer_Suppress(idle_ms))
+    {
+        SchedlTimer_Stop();
+        OS_WaitForInterrupt();
 
-    SchedlTimer_Start();
-    OSAsm_Start();
+        /* The ticks elapsed are always fewer than idle_ms, no timeout expires here */
+        TimingWheel_Skip(&Timeouts, TickTimer_Resume());
+        SchedlTimer_Start();
+    }
+    else
+#endif
+    {
+        OS_WaitForInterrupt();
+    }
+    IdleCycles += DWT->CYCCNT - sleep_start_cycles;
 
-    /* This statement should not be reached */
-    panic();
+    /* Let the pending ISRs run */
+    OS_Critical_Exit();
+    __ISB();
+    OS_Critical_Enter();
 }
 
-void OS_Scheduler(void)
+static void OS_WaitForInterrupt(void)
 {
-    /* If this fn has been invoked by OS_Thread_Kill, the current TCB has been removed from the
-     * linked list, so it's correct to start iterating from the next TCB */
-    TCB_t *next_pt = RunPt->next;
-    TCB_t *iterating_pt = next_pt;
+    __disable_irq();
+    OS_Critical_Exit();
+    __DSB();
+    __WFI();
+    __ISB();
+    OS_Critical_Enter();
+}
 
-    /* Search for highest priority thread not sleeping or blocked */
-    uint32_t max_priority = UINT8_MAX + 1;
-    TCB_t *best_pt = next_pt;
-    do
+static void OS_CPULoad_Update(void)
+{
+    uint32_t period_duration_ms = HAL_GetTick() - LoadPeriodStartTick;
+    if (period_duration_ms < OS_CPULOAD_PERIOD_MS)
     {
-        if ((iterating_pt->priority < max_priority) && (iterating_pt->sleep == 0) && (iterating_pt->blocked == NULL))
-        {
-            best_pt = iterating_pt;
-            max_priority = best_pt->priority;
-        }
-        iterating_pt = iterating_pt->next;
-    } while (iterating_pt != next_pt);
+        return;
+    }
 
-    RunPt = best_pt;
+    uint32_t cycles = DWT->CYCCNT;
+    uint32_t counted_cycles = cycles - LoadPeriodStartCycles;
+    LoadBusyCycles[LoadIdx] = (counted_cycles > IdleCycles) ? (counted_cycles - IdleCycles) : 0;
+    LoadPeriodDurationMs[LoadIdx] = period_duration_ms;
+    LoadIdx = (LoadIdx + 1) % OS_CPULOAD_WINDOW;
+
+    LoadPeriodStartTick += period_duration_ms;
+    LoadPeriodStartCycles = cycles;
+    IdleCycles = 0;
 }
 
-void OS_Thread_Suspend(void)
+#if OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_CANARY
+OS_HOT_CODE static void OS_Stack_CheckOverflow(TCB_t *tcb)
+{
+    if ((tcb->sp <= tcb->stack_base) || (tcb->stack_base[0] != OS_STACK_PAINT))
+    {
+        OverflowedThreadName = tcb->name;
+        panic();
+    }
+}
+#elif OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_MPU
+static void OS_Stack_InitGuard(void)
 {
-    SchedlTimer_ResetCounter();
+    MPU_Region_InitTypeDef region = {
+        .Enable = MPU_REGION_ENABLE,
+        .Number = OS_MPU_GUARD_REGION,
+        .BaseAddress = (uint32_t)TCBs[OS_IDLE_TCB_IDX].stack_base,
+        .Size = MPU_REGION_SIZE_32B,
+        .SubRegionDisable = 0x00,
+        .TypeExtField = MPU_TEX_LEVEL0,
+        .AccessPermission = MPU_REGION_NO_ACCESS,
+        .DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE,
+        .IsShareable = MPU_ACCESS_SHAREABLE,
+        .IsCacheable = MPU_ACCESS_CACHEABLE,
+        .IsBufferable = MPU_ACCESS_NOT_BUFFERABLE,
+    };
+    HAL_MPU_Disable();
+    HAL_MPU_ConfigRegion(&region);
+    HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+    __DSB();
+    __ISB();
 }
 
-void OS_Thread_Sleep(uint32_t sleep_duration_ms)
+OS_HOT_CODE static void OS_Stack_MoveGuard(TCB_t *tcb)
 {
-    RunPt->sleep = sleep_duration_ms;
-    OS_Thread_Suspend();
+    /* With the VALID bit set, RBAR selects the region too. The size and permissions don't change.
+     * Called from PendSV, the exception return makes the new region effective before the thread runs */
+    MPU->RBAR = (uint32_t)tcb->stack_base | MPU_RBAR_VALID_Msk | OS_MPU_GUARD_REGION;
 }
+#endif
 
-void OS_DecrementTCBsSleepDuration(void)
+void OS_Stack_RecordOverflow(void)
 {
-    for (size_t tcb_idx = 0; tcb_idx < MAXNUMTHREADS; tcb_idx++)
-    {
-        if (TCBs[tcb_idx].sleep > 0)
-        {
-            TCBs[tcb_idx].sleep -= 1;
-        }
-    }
+    OverflowedThreadName = (RunPt != NULL) ? RunPt->name : NULL;
 }
 
-void OS_Thread_Kill(void)
+void OS_Init(uint32_t scheduler_frequency_hz)
 {
-    assert_or_panic(ActiveTCBsCount > 1);
-    __disable_irq();
+    SchedlTimer_Init(scheduler_frequency_hz);
 
-    TCB_t *previous_tcb = RunPt;
-    while (1)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    LoadPeriodStartTick = HAL_GetTick();
+    LoadPeriodStartCycles = DWT->CYCCNT;
+
+    TimingWheel_Init(&Timeouts);
+    OS_InitTCBsStatus();
+    OS_StackPool_Assign(OS_IDLE_TCB_IDX, OS_IDLE_STACKSIZE);
+    OS_InitTCB(OS_IDLE_TCB_IDX, OS_IdleThread, OS_SCHEDL_PRIO_MIN, "OS_IdleThread");
+    OS_ReadyList_Insert(&(TCBs[OS_IDLE_TCB_IDX]));
+#if OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_MPU
+    OS_Stack_InitGuard();
+#endif
+}
+
+static void OS_SetInitialStack(uint32_t tcb_idx)
+{
+    uint32_t *stack = TCBs[tcb_idx].stack_base;
+    uint32_t stack_size = TCBs[tcb_idx].stack_size;
+
+    for (uint32_t idx = 0; idx < stack_size; idx++)
     {
-        previous_tcb = previous_tcb->next;
-        if (previous_tcb->next == RunPt)
-            break;
+        stack[idx] = OS_STACK_PAINT;
     }
-    TCB_t *next_tcb = RunPt->next;
 
-    previous_tcb->next = next_tcb;
-    RunPt->status = TCBStateFree;
+    /* From the "STM32 Cortex-M4 Programming Manual" on page 23:
+     * attempting to execute instructions when  the T bit is 0 results in a fault or lockup */
+    stack[stack_size - 1] = 0x01000000; /* Thumb Bit (PSR) */
+    // stack[stack_size - 2] =           /* R15 (PC) -> set later in fn OS_AddThreads
+    stack[stack_size - 3] = 0x14141414;               /* R14 (LR) */
+    stack[stack_size - 4] = 0x12121212;               /* R12 */
+    stack[stack_size - 5] = 0x03030303;               /* R3 */
+    stack[stack_size - 6] = 0x02020202;               /* R2 */
+    stack[stack_size - 7] = 0x01010101;               /* R1 */
+    stack[stack_size - 8] = 0x00000000;               /* R0 */
+    stack[stack_size - 9] = OS_EXC_RETURN_THREAD_PSP; /* EXC_RETURN */
+    stack[stack_size - 10] = 0x11111111;              /* R11 */
+    stack[stack_size - 11] = 0x10101010;              /* R10 */
+    stack[stack_size - 12] = 0x09090909;              /* R9 */
+    stack[stack_size - 13] = 0x08080808;              /* R8 */
+    stack[stack_size - 14] = 0x07070707;              /* R7 */
+    stack[stack_size - 15] = 0x06060606;              /* R6 */
+    stack[stack_size - 16] = 0x05050505;              /* R5 */
+    stack[stack_size - 17] = 0x04040404;              /* R4 */
 
-    ActiveTCBsCount--;
-    __enable_irq();
-    OS_Thread_Suspend();
+    TCBs[tcb_idx].sp = &stack[stack_size - 17]; /* Thread's stack pointer */
 }
 
-void OS_Semaphore_Wait(Semaphore_t *sem)
+static void OS_InitTCB(uint32_t tcb_idx, void (*task)(void), uint8_t priority, const char *name)
 {
-    __disable_irq();
-    (*sem) = (*sem) - 1;
-    if ((*sem) < 0)
+    TCBs[tcb_idx].timeout = (Timeout_t){.arg = &(TCBs[tcb_idx])};
+    TCBs[tcb_idx].status = TCBStateReady;
+    TCBs[tcb_idx].blocked = NULL;
+    TCBs[tcb_idx].priority = priority;
+    TCBs[tcb_idx].base_priority = priority;
+    TCBs[tcb_idx].held_mutexes = NULL;
+    TCBs[tcb_idx].waited_mutex = NULL;
+    TCBs[tcb_idx].waited_sem = NULL;
+    TCBs[tcb_idx].timed_out = false;
+    TCBs[tcb_idx].notify_value = 0;
+    TCBs[tcb_idx].notify_pending = false;
+    TCBs[tcb_idx].notify_waiting = false;
+    TCBs[tcb_idx].name = name;
+
+    OS_SetInitialStack(tcb_idx);
+    TCBs[tcb_idx].stack_base[TCBs[tcb_idx].stack_size - 2] = (int32_t)task; /* PC */
+}
+
+static void OS_StackPool_Assign(uint32_t tcb_idx, uint32_t stack_size)
+{
+    stack_size = OS_STACK_ROUNDUP(stack_size);
+    assert_or_panic(stack_size >= OS_STACKSIZE_MIN);
+    TCB_t *tcb = &(TCBs[tcb_idx]);
+    if ((tcb->stack_base != NULL) && tcb->stack_from_pool && (tcb->stack_size >= stack_size))
     {
-        RunPt->blocked = sem; /* Reason the thread is blocked */
-        __enable_irq();
-        OS_Thread_Suspend();
+        return;
     }
-    __enable_irq();
+
+    assert_or_panic(StackPoolNext + stack_size <= &StackPool[OS_STACKPOOL_SIZE]);
+    tcb->stack_base = StackPoolNext;
+    tcb->stack_size = stack_size;
+    tcb->stack_from_pool = true;
+    StackPoolNext += stack_size;
 }
 
-void OS_Semaphore_Signal(Semaphore_t *sem)
+static uint32_t OS_FindFreeTCB(uint32_t stack_size)
 {
-    __disable_irq();
-    (*sem) = (*sem) + 1;
-    if ((*sem) <= 0)
+    uint32_t best_idx = MAXNUMTHREADS;
+    uint32_t empty_idx = MAXNUMTHREADS;
+    uint32_t free_idx = MAXNUMTHREADS;
+    for (uint32_t idx = 0; idx < MAXNUMTHREADS; idx++)
     {
-        /* Search for a TCB blocked on this semaphore and wake it up */
-        TCB_t *a_tcb = RunPt->next;
-        while (a_tcb->blocked != sem)
+        TCB_t *tcb = &(TCBs[idx]);
+        if (tcb->status != TCBStateFree)
+        {
+            continue;
+        }
+        free_idx = (free_idx == MAXNUMTHREADS) ? idx : free_idx;
+        if (tcb->stack_base == NULL)
         {
-            a_tcb = a_tcb->next;
+            empty_idx = (empty_idx == MAXNUMTHREADS) ? idx : empty_idx;
         }
-        a_tcb->blocked = 0;
+        else if ((tcb->stack_size >= stack_size) &&
+                 ((best_idx == MAXNUMTHREADS) || (tcb->stack_size < TCBs[best_idx].stack_size)))
+        {
+            best_idx = idx;
+        }
+    }
+
+    uint32_t tcb_idx = (best_idx != MAXNUMTHREADS) ? best_idx : (empty_idx != MAXNUMTHREADS) ? empty_idx : free_idx;
+    assert_or_panic(tcb_idx != MAXNUMTHREADS);
+    return tcb_idx;
+}
+
+ThreadHandle_t OS_Thread_CreateFirst(void (*task)(void), uint8_t priority, const char *name, uint32_t stack_size)
+{
+    assert_or_panic(ActiveTCBsCount == 0);
+    OS_StackPool_Assign(0, stack_size);
+    OS_InitTCB(0, task, priority, name);
+    OS_ReadyList_Insert(&(TCBs[0]));
+
+    /* Thread 0 will run first */
+    RunPt = &(TCBs[0]);
+    ActiveTCBsCount++;
+    return RunPt;
+}
+
+ThreadHandle_t OS_Thread_Create(void (*task)(void), uint8_t priority, const char *name, uint32_t stack_size)
+{
+    assert_or_panic(ActiveTCBsCount > 0 && ActiveTCBsCount < MAXNUMTHREADS);
+    OS_Critical_Enter();
+
+    uint32_t new_tcb_idx = OS_FindFreeTCB(OS_STACK_ROUNDUP(stack_size));
+    OS_StackPool_Assign(new_tcb_idx, stack_size);
+    OS_InitTCB(new_tcb_idx, task, priority, name);
+    OS_MakeReady(&(TCBs[new_tcb_idx]));
+
+    ActiveTCBsCount++;
+    OS_Critical_Exit();
+    return &(TCBs[new_tcb_idx]);
+}
+
+ThreadHandle_t OS_Thread_CreateWithStack(void (*task)(void), uint8_t priority, const char *name, uint32_t *stack,
+                                         uint32_t stack_size)
+{
+    assert_or_panic(ActiveTCBsCount > 0 && ActiveTCBsCount < MAXNUMTHREADS);
+    assert_or_panic(((uint32_t)stack % OS_STACK_ALIGN == 0) && (stack_size == OS_STACK_ROUNDUP(stack_size)) &&
+                    (stack_size >= OS_STACKSIZE_MIN));
+    OS_Critical_Enter();
+
+    /* No pool stack fits UINT32_MAX words, so a TCB with no stack is picked, if any */
+    uint32_t new_tcb_idx = OS_FindFreeTCB(UINT32_MAX);
+    assert_or_panic(TCBs[new_tcb_idx].stack_base == NULL);
+    TCBs[new_tcb_idx].stack_base = stack;
+    TCBs[new_tcb_idx].stack_size = stack_size;
+    TCBs[new_tcb_idx].stack_from_pool = false;
+    OS_InitTCB(new_tcb_idx, task, priority, name);
+    OS_MakeReady(&(TCBs[new_tcb_idx]));
+
+    ActiveTCBsCount++;
+    OS_Critical_Exit();
+    return &(TCBs[new_tcb_idx]);
+}
+
+ThreadHandle_t OS_Thread_GetCurrent(void)
+{
+    return RunPt;
+}
+
+void OS_Launch(void)
+{
+    assert_or_panic(ActiveTCBsCount > 0);
+
+    /* Prevent the timer's ISR from firing before OSAsm_Start is called, which enables the interrupts again */
+    __disable_irq();
+
+    HAL_NVIC_SetPriority(PendSV_IRQn, OS_PENDSV_PRIORITY, 0);
+
+    /* Threads created after the first one might have a higher priority */
+    RunPt = OS_ReadyList_GetHighest();
+    IsRunning = true;
+#if OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_MPU
+    OS_Stack_MoveGuard(RunPt);
+#endif
+
+    SchedlTimer_Start();
+    OSAsm_Start();
+
+    /* This statement should not be reached */
+    panic();
+}
+
+OS_HOT_CODE void OS_Scheduler(void)
+{
+#if OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_CANARY
+    OS_Stack_CheckOverflow(RunPt);
+#endif
+
+    /* If this fn has been invoked by OS_Thread_Kill, OS_Thread_Sleep or OS_Semaphore_Wait,
+     * the current TCB has already been removed from its ready list.
+     * The idle thread is always ready, so there's always a thread to run */
+    TCB_t *best_pt = OS_ReadyList_GetHighest();
+
+    /* Round-robin among the threads with the same priority */
+    if (best_pt == RunPt)
+    {
+        ReadyLists[RunPt->priority] = RunPt->next;
+        best_pt = RunPt->next;
+    }
+    RunPt = best_pt;
+#if OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_MPU
+    OS_Stack_MoveGuard(RunPt);
+#endif
+}
+
+bool OS_IsRunning(void)
+{
+    return IsRunning;
+}
+
+void OS_Scheduler_Invoke(void)
+{
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    /* Make sure the exception is taken before the next instruction, if interrupts are enabled */
+    __DSB();
+    __ISB();
+}
+
+void OS_Thread_Suspend(void)
+{
+    OS_Scheduler_Invoke();
+}
+
+void OS_Thread_Sleep(uint32_t sleep_duration_ms)
+{
+    OS_Critical_Enter();
+    if (sleep_duration_ms > 0)
+    {
+        OS_ReadyList_Remove(RunPt);
+        RunPt->status = TCBStateSleeping;
+        TimingWheel_Insert(&Timeouts, &(RunPt->timeout), sleep_duration_ms);
+    }
+    OS_Scheduler_Invoke();
+    OS_Critical_Exit();
+}
+
+void OS_Tick(void)
+{
+    TimingWheelEntry_t *expired = NULL;
+    OS_Critical_Enter();
+    TimingWheel_Tick(&Timeouts, &expired);
+
+    /* The threads' timeouts first, the others are left in the list */
+    TimingWheelEntry_t **link = &expired;
+    while (*link != NULL)
+    {
+        Timeout_t *timeout = *link;
+        if (timeout->callback != NULL)
+        {
+            link = &(timeout->next);
+            continue;
+        }
+        TimingWheel_Remove(&Timeouts, timeout);
+        TCB_t *woken_tcb = timeout->arg;
+        if (woken_tcb->status == TCBStateBlocked)
+        {
+            OS_Thread_ExpireWait(woken_tcb);
+        }
+        OS_MakeReady(woken_tcb);
+    }
+    OS_CPULoad_Update();
+
+    /* Each timeout is disarmed before its callback runs, so that the callback can start it again,
+     * or cancel the ones expiring on the same tick */
+    while (expired != NULL)
+    {
+        Timeout_t *timeout = expired;
+        TimingWheel_Remove(&Timeouts, timeout);
+        OS_Critical_Exit();
+        timeout->callback(timeout->arg);
+        OS_Critical_Enter();
+    }
+    OS_Critical_Exit();
+}
+
+static void OS_WaitList_Insert(TCB_t **wait_list, TCB_t *tcb)
+{
+    TCB_t **link = wait_list;
+    while ((*link != NULL) && ((*link)->priority <= tcb->priority))
+    {
+        link = &((*link)->next);
+    }
+    tcb->next = *link;
+    *link = tcb;
+    tcb->blocked = wait_list;
+}
+
+static TCB_t *OS_WaitList_PopFirst(TCB_t **wait_list)
+{
+    TCB_t *tcb = *wait_list;
+    *wait_list = tcb->next;
+    tcb->blocked = NULL;
+    tcb->waited_mutex = NULL;
+    tcb->waited_sem = NULL;
+    return tcb;
+}
+
+static void OS_WaitList_Remove(TCB_t *tcb)
+{
+    TCB_t **link = tcb->blocked;
+    while (*link != tcb)
+    {
+        link = &((*link)->next);
+    }
+    *link = tcb->next;
+    tcb->blocked = NULL;
+}
+
+static void OS_Thread_Block(TCB_t **wait_list, uint32_t timeout_ms)
+{
+    OS_ReadyList_Remove(RunPt);
+    RunPt->status = TCBStateBlocked;
+    RunPt->timed_out = false;
+    if (wait_list != NULL)
+    {
+        OS_WaitList_Insert(wait_list, RunPt);
+    }
+    if (timeout_ms != OS_NO_TIMEOUT)
+    {
+        TimingWheel_Insert(&Timeouts, &(RunPt->timeout), timeout_ms);
+    }
+    OS_Scheduler_Invoke();
+}
+
+static void OS_Thread_ExpireWait(TCB_t *tcb)
+{
+    if (tcb->blocked != NULL)
+    {
+        OS_WaitList_Remove(tcb);
+    }
+    tcb->notify_waiting = false;
+    tcb->timed_out = true;
+    if (tcb->waited_sem != NULL)
+    {
+        /* The thread is no longer counted among the ones blocked */
+        tcb->waited_sem->counter += 1;
+        tcb->waited_sem = NULL;
+    }
+    if (tcb->waited_mutex != NULL)
+    {
+        /* The owner might no longer inherit the thread's priority */
+        Mutex_t *mutex = tcb->waited_mutex;
+        tcb->waited_mutex = NULL;
+        OS_Mutex_PropagatePriority(mutex);
+    }
+}
+
+static void OS_SetPriority(TCB_t *tcb, uint8_t priority)
+{
+    if (tcb->priority == priority)
+    {
+        return;
+    }
+
+    if (tcb->status == TCBStateReady)
+    {
+        OS_ReadyList_Remove(tcb);
+        tcb->priority = priority;
+        OS_ReadyList_Insert(tcb);
+        if ((tcb == RunPt) || (priority < RunPt->priority))
+        {
+            OS_Scheduler_Invoke();
+        }
+    }
+    else if ((tcb->status == TCBStateBlocked) && (tcb->blocked != NULL))
+    {
+        TCB_t **wait_list = tcb->blocked;
+        OS_WaitList_Remove(tcb);
+        tcb->priority = priority;
+        OS_WaitList_Insert(wait_list, tcb);
+    }
+    else
+    {
+        tcb->priority = priority;
+    }
+}
+
+static uint8_t OS_Mutex_GetInheritedPriority(TCB_t *tcb)
+{
+    uint8_t priority = tcb->base_priority;
+    for (Mutex_t *mutex = tcb->held_mutexes; mutex != NULL; mutex = mutex->next_held)
+    {
+        /* Wait lists are ordered by priority, the first waiter has the highest one */
+        if ((mutex->waiters != NULL) && (mutex->waiters->priority < priority))
+        {
+            priority = mutex->waiters->priority;
+        }
+    }
+    return priority;
+}
+
+static void OS_Mutex_PropagatePriority(Mutex_t *mutex)
+{
+    for (uint32_t depth = 0; (mutex != NULL) && (depth < OS_NUMTCBS); depth++)
+    {
+        TCB_t *owner = mutex->owner;
+        uint8_t priority = OS_Mutex_GetInheritedPriority(owner);
+        if (priority == owner->priority)
+        {
+            break;
+        }
+        OS_SetPriority(owner, priority);
+        mutex = owner->waited_mutex;
+    }
+}
+
+void OS_Idle_AddHook(void (*hook)(void))
+{
+    assert_or_panic(IdleHooksCount < OS_MAXNUMIDLEHOOKS);
+    OS_Critical_Enter();
+    IdleHooks[IdleHooksCount] = hook;
+    IdleHooksCount++;
+    OS_Critical_Exit();
+}
+
+uint32_t OS_CPULoad_Get(void)
+{
+    uint64_t busy_cycles = 0;
+    uint64_t duration_ms = 0;
+    OS_Critical_Enter();
+    for (uint32_t idx = 0; idx < OS_CPULOAD_WINDOW; idx++)
+    {
+        busy_cycles += LoadBusyCycles[idx];
+        duration_ms += LoadPeriodDurationMs[idx];
+    }
+    OS_Critical_Exit();
+
+    if (duration_ms == 0)
+    {
+        return 0;
+    }
+    uint64_t total_cycles = duration_ms * (SystemCoreClock / 1000U);
+    uint64_t load_percent = (busy_cycles * 100U) / total_cycles;
+    return (load_percent > 100U) ? 100U : (uint32_t)load_percent;
+}
+
+uint32_t OS_Stack_GetUsage(StackUsage_t *usages, uint32_t max_count)
+{
+    uint32_t count = 0;
+    for (uint32_t tcb_idx = 0; (tcb_idx < OS_NUMTCBS) && (count < max_count); tcb_idx++)
+    {
+        /* Take a snapshot of the TCB, so that the stack can be scanned with interrupts enabled */
+        OS_Critical_Enter();
+        TCB_t *tcb = &(TCBs[tcb_idx]);
+        bool is_active = (tcb->status != TCBStateFree);
+        const char *name = tcb->name;
+        uint32_t *stack = tcb->stack_base;
+        uint32_t stack_size = tcb->stack_size;
+        OS_Critical_Exit();
+        if (!is_active || (stack == NULL))
+        {
+            continue;
+        }
+
+        uint32_t unused_words = OS_STACK_GUARD_WORDS;
+        while ((unused_words < stack_size) && (stack[unused_words] == OS_STACK_PAINT))
+        {
+            unused_words++;
+        }
+        usages[count].name = name;
+        usages[count].stack_size = stack_size;
+        usages[count].stack_used = stack_size - unused_words;
+        count++;
+    }
+    return count;
+}
+
+void OS_Thread_Kill(void)
+{
+    assert_or_panic(RunPt != &(TCBs[OS_IDLE_TCB_IDX]));
+    assert_or_panic(RunPt->held_mutexes == NULL);
+    OS_Critical_Enter();
+
+    OS_ReadyList_Remove(RunPt);
+    RunPt->status = TCBStateFree;
+
+    /* A pool stack stays with the TCB for the next thread, a caller's stack is given back */
+    if (!RunPt->stack_from_pool)
+    {
+        RunPt->stack_base = NULL;
+    }
+
+    ActiveTCBsCount--;
+    OS_Scheduler_Invoke();
+    OS_Critical_Exit();
+
+    /* This statement should not be reached */
+    panic();
+}
+
+void OS_Thread_Notify(ThreadHandle_t thread, NotifyAction_t action, uint32_t value)
+{
+    OS_Critical_Enter();
+    assert_or_panic(thread->status != TCBStateFree);
+    switch (action)
+    {
+    case NotifyActionSetBits:
+        thread->notify_value |= value;
+        break;
+    case NotifyActionIncrement:
+        thread->notify_value += 1;
+        break;
+    case NotifyActionOverwrite:
+        thread->notify_value = value;
+        break;
+    case NotifyActionNone:
+    default:
+        break;
+    }
+    thread->notify_pending = true;
+    if (thread->notify_waiting)
+    {
+        thread->notify_waiting = false;
+        OS_MakeReady(thread);
+    }
+    OS_Critical_Exit();
+}
+
+void OS_Thread_NotifyGive(ThreadHandle_t thread)
+{
+    OS_Thread_Notify(thread, NotifyActionIncrement, 0);
+}
+
+uint32_t OS_Thread_NotifyWait(uint32_t clear_on_exit)
+{
+    OS_Critical_Enter();
+    if (!RunPt->notify_pending)
+    {
+        RunPt->notify_waiting = true;
+        OS_Thread_Block(NULL, OS_NO_TIMEOUT);
+        /* The thread is switched out here, and runs again once notified */
+        OS_Critical_Exit();
+        OS_Critical_Enter();
+    }
+    uint32_t value = RunPt->notify_value;
+    RunPt->notify_value &= ~clear_on_exit;
+    RunPt->notify_pending = false;
+    OS_Critical_Exit();
+    return value;
+}
+
+HAL_StatusTypeDef OS_Thread_NotifyWaitTimeout(uint32_t clear_on_exit, uint32_t *value, uint32_t timeout_ms)
+{
+    OS_Critical_Enter();
+    if (!RunPt->notify_pending && (timeout_ms > 0))
+    {
+        RunPt->notify_waiting = true;
+        OS_Thread_Block(NULL, timeout_ms);
+        /* The thread is switched out here, and runs again once notified or once the timeout expires */
+        OS_Critical_Exit();
+        OS_Critical_Enter();
+    }
+    if (!RunPt->notify_pending)
+    {
+        OS_Critical_Exit();
+        return HAL_TIMEOUT;
+    }
+    *value = RunPt->notify_value;
+    RunPt->notify_value &= ~clear_on_exit;
+    RunPt->notify_pending = false;
+    OS_Critical_Exit();
+    return HAL_OK;
+}
+
+void OS_Timeout_Init(Timeout_t *timeout, void (*callback)(void *arg), void *arg)
+{
+    assert_or_panic(callback != NULL);
+    *timeout = (Timeout_t){.callback = callback, .arg = arg};
+}
+
+void OS_Timeout_Start(Timeout_t *timeout, uint32_t timeout_ms)
+{
+    OS_Critical_Enter();
+    if (TimingWheel_IsArmed(timeout))
+    {
+        TimingWheel_Remove(&Timeouts, timeout);
+    }
+    TimingWheel_Insert(&Timeouts, timeout, timeout_ms);
+    OS_Critical_Exit();
+}
+
+void OS_Timeout_Cancel(Timeout_t *timeout)
+{
+    OS_Critical_Enter();
+    if (TimingWheel_IsArmed(timeout))
+    {
+        TimingWheel_Remove(&Timeouts, timeout);
+    }
+    OS_Critical_Exit();
+}
+
+bool OS_Timeout_IsActive(Timeout_t *timeout)
+{
+    OS_Critical_Enter();
+    bool is_active = TimingWheel_IsArmed(timeout);
+    OS_Critical_Exit();
+    return is_active;
+}
+
+void OS_Mutex_Init(Mutex_t *mutex)
+{
+    mutex->owner = NULL;
+    mutex->lock_count = 0;
+    mutex->waiters = NULL;
+    mutex->next_held = NULL;
+}
+
+void OS_Mutex_Lock(Mutex_t *mutex)
+{
+    OS_Critical_Enter();
+    if (mutex->owner == NULL)
+    {
+        mutex->owner = RunPt;
+        mutex->lock_count = 1;
+        mutex->next_held = RunPt->held_mutexes;
+        RunPt->held_mutexes = mutex;
+    }
+    else if (mutex->owner == RunPt)
+    {
+        mutex->lock_count += 1;
+    }
+    else
+    {
+        /* The mutex is handed over by OS_Mutex_Unlock, the thread owns it once it's woken up */
+        RunPt->waited_mutex = mutex;
+        OS_Thread_Block(&(mutex->waiters), OS_NO_TIMEOUT);
+        OS_Mutex_PropagatePriority(mutex);
+    }
+    OS_Critical_Exit();
+}
+
+HAL_StatusTypeDef OS_Mutex_LockTimeout(Mutex_t *mutex, uint32_t timeout_ms)
+{
+    OS_Critical_Enter();
+    if (mutex->owner == NULL)
+    {
+        mutex->owner = RunPt;
+        mutex->lock_count = 1;
+        mutex->next_held = RunPt->held_mutexes;
+        RunPt->held_mutexes = mutex;
+        OS_Critical_Exit();
+        return HAL_OK;
+    }
+    if (mutex->owner == RunPt)
+    {
+        mutex->lock_count += 1;
+        OS_Critical_Exit();
+        return HAL_OK;
+    }
+    if (timeout_ms == 0)
+    {
+        OS_Critical_Exit();
+        return HAL_TIMEOUT;
+    }
+
+    RunPt->waited_mutex = mutex;
+    OS_Thread_Block(&(mutex->waiters), timeout_ms);
+    OS_Mutex_PropagatePriority(mutex);
+    OS_Critical_Exit();
+
+    /* The thread runs again either as the new owner, or because the timeout expired */
+    return RunPt->timed_out ? HAL_TIMEOUT : HAL_OK;
+}
+
+HAL_StatusTypeDef OS_Mutex_TryLock(Mutex_t *mutex)
+{
+    OS_Critical_Enter();
+    if (mutex->owner == NULL)
+    {
+        mutex->owner = RunPt;
+        mutex->lock_count = 1;
+        mutex->next_held = RunPt->held_mutexes;
+        RunPt->held_mutexes = mutex;
+    }
+    else if (mutex->owner == RunPt)
+    {
+        mutex->lock_count += 1;
+    }
+    else
+    {
+        OS_Critical_Exit();
+        return HAL_BUSY;
+    }
+    OS_Critical_Exit();
+    return HAL_OK;
+}
+
+void OS_Mutex_Unlock(Mutex_t *mutex)
+{
+    assert_or_panic(mutex->owner == RunPt);
+    OS_Critical_Enter();
+    mutex->lock_count -= 1;
+    if (mutex->lock_count > 0)
+    {
+        OS_Critical_Exit();
+        return;
+    }
+
+    /* Mutexes are usually unlocked in reverse order, so the search ends at the first iteration */
+    Mutex_t **link = &(RunPt->held_mutexes);
+    while (*link != mutex)
+    {
+        link = &((*link)->next_held);
+    }
+    *link = mutex->next_held;
+    OS_SetPriority(RunPt, OS_Mutex_GetInheritedPriority(RunPt));
+
+    if (mutex->waiters == NULL)
+    {
+        mutex->owner = NULL;
+        OS_Critical_Exit();
+        return;
+    }
+
+    TCB_t *new_owner = OS_WaitList_PopFirst(&(mutex->waiters));
+    mutex->owner = new_owner;
+    mutex->lock_count = 1;
+    mutex->next_held = new_owner->held_mutexes;
+    new_owner->held_mutexes = mutex;
+
+    /* The new owner inherits the priority of the threads still waiting */
+    new_owner->priority = OS_Mutex_GetInheritedPriority(new_owner);
+    OS_MakeReady(new_owner);
+    OS_Critical_Exit();
+}
+
+static bool OS_Semaphore_TryDecrement(Semaphore_t *sem)
+{
+    volatile uint32_t *counter_addr = (volatile uint32_t *)&(sem->counter);
+    int32_t counter;
+    do
+    {
+        counter = (int32_t)__LDREXW(counter_addr);
+        if (counter <= 0)
+        {
+            __CLREX();
+            return false;
+        }
+    } while (__STREXW((uint32_t)(counter - 1), counter_addr) != 0);
+    return true;
+}
+
+static bool OS_Semaphore_TryIncrement(Semaphore_t *sem)
+{
+    volatile uint32_t *counter_addr = (volatile uint32_t *)&(sem->counter);
+    int32_t counter;
+    do
+    {
+        counter = (int32_t)__LDREXW(counter_addr);
+        if (counter < 0)
+        {
+            __CLREX();
+            return false;
+        }
+    } while (__STREXW((uint32_t)(counter + 1), counter_addr) != 0);
+    return true;
+}
+
+void OS_Semaphore_Init(Semaphore_t *sem, int32_t initial_counter)
+{
+    sem->counter = initial_counter;
+    sem->waiters = NULL;
+}
+
+void OS_Semaphore_Wait(Semaphore_t *sem)
+{
+    if (OS_Semaphore_TryDecrement(sem))
+    {
+        return;
+    }
+
+    /* The counter might have been signaled in the meantime, the thread blocks only if it's still not positive */
+    OS_Critical_Enter();
+    sem->counter -= 1;
+    if (sem->counter < 0)
+    {
+        RunPt->waited_sem = sem;
+        OS_Thread_Block(&(sem->waiters), OS_NO_TIMEOUT);
+    }
+    OS_Critical_Exit();
+}
+
+HAL_StatusTypeDef OS_Semaphore_WaitTimeout(Semaphore_t *sem, uint32_t timeout_ms)
+{
+    if (OS_Semaphore_TryDecrement(sem))
+    {
+        return HAL_OK;
+    }
+
+    OS_Critical_Enter();
+    if (sem->counter > 0)
+    {
+        sem->counter -= 1;
+        OS_Critical_Exit();
+        return HAL_OK;
+    }
+    if (timeout_ms == 0)
+    {
+        OS_Critical_Exit();
+        return HAL_TIMEOUT;
+    }
+
+    sem->counter -= 1;
+    RunPt->waited_sem = sem;
+    OS_Thread_Block(&(sem->waiters), timeout_ms);
+    OS_Critical_Exit();
+
+    /* The thread runs again either because the semaphore was signaled, or because the timeout expired */
+    return RunPt->timed_out ? HAL_TIMEOUT : HAL_OK;
+}
+
+HAL_StatusTypeDef OS_Semaphore_TryWait(Semaphore_t *sem)
+{
+    return OS_Semaphore_TryDecrement(sem) ? HAL_OK : HAL_BUSY;
+}
+
+void OS_Semaphore_Signal(Semaphore_t *sem)
+{
+    if (OS_Semaphore_TryIncrement(sem))
+    {
+        return;
+    }
+
+    OS_Critical_Enter();
+    sem->counter += 1;
+    if (sem->counter <= 0)
+    {
+        OS_MakeReady(OS_WaitList_PopFirst(&(sem->waiters)));
+    }
+    OS_Critical_Exit();
+}
+
+uint32_t OS_Semaphore_WaitUpTo(Semaphore_t *sem, uint32_t max_count)
+{
+    assert_or_panic(max_count > 0);
+    OS_Critical_Enter();
+    if (sem->counter <= 0)
+    {
+        /* Once woken up, the thread owns the unit the signal was for */
+        sem->counter -= 1;
+        RunPt->waited_sem = sem;
+        OS_Thread_Block(&(sem->waiters), OS_NO_TIMEOUT);
+        OS_Critical_Exit();
+        if (max_count == 1)
+        {
+            return 1;
+        }
+        OS_Critical_Enter();
+        uint32_t extra_count = (sem->counter > 0) ? (uint32_t)sem->counter : 0;
+        extra_count = (extra_count < max_count - 1) ? extra_count : max_count - 1;
+        sem->counter -= (int32_t)extra_count;
+        OS_Critical_Exit();
+        return 1 + extra_count;
+    }
+    uint32_t count = ((uint32_t)sem->counter < max_count) ? (uint32_t)sem->counter : max_count;
+    sem->counter -= (int32_t)count;
+    OS_Critical_Exit();
+    return count;
+}
+
+void OS_Semaphore_SignalN(Semaphore_t *sem, uint32_t count)
+{
+    OS_Critical_Enter();
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        sem->counter += 1;
+        if (sem->counter <= 0)
+        {
+            OS_MakeReady(OS_WaitList_PopFirst(&(sem->waiters)));
+        }
+    }
+    OS_Critical_Exit();
+}
+
+void OS_EventFlags_Init(EventFlags_t *event_flags)
+{
+    event_flags->flags = 0;
+    event_flags->waited_flags = 0;
+    event_flags->waiters = NULL;
+}
+
+void OS_EventFlags_Set(EventFlags_t *event_flags, uint32_t flags)
+{
+    OS_Critical_Enter();
+    event_flags->flags |= flags;
+    if ((flags & event_flags->waited_flags) == 0)
+    {
+        OS_Critical_Exit();
+        return;
+    }
+
+    uint32_t clear_flags = 0;
+    uint32_t waited_flags = 0;
+    TCB_t **link = &(event_flags->waiters);
+    while (*link != NULL)
+    {
+        TCB_t *tcb = *link;
+        if (!OS_EventFlags_IsSatisfied(event_flags->flags, tcb->event_flags, tcb->event_options))
+        {
+            waited_flags |= tcb->event_flags;
+            link = &(tcb->next);
+            continue;
+        }
+
+        if (tcb->event_options & OS_EVENTFLAGS_CLEAR_ON_EXIT)
+        {
+            clear_flags |= tcb->event_flags;
+        }
+        tcb->event_flags &= event_flags->flags;
+        /* Popping from the link unlinks the TCB, the next one takes its place */
+        OS_MakeReady(OS_WaitList_PopFirst(link));
+    }
+    event_flags->waited_flags = waited_flags;
+    event_flags->flags &= ~clear_flags;
+    OS_Critical_Exit();
+}
+
+void OS_EventFlags_Clear(EventFlags_t *event_flags, uint32_t flags)
+{
+    OS_Critical_Enter();
+    event_flags->flags &= ~flags;
+    OS_Critical_Exit();
+}
+
+uint32_t OS_EventFlags_Get(EventFlags_t *event_flags)
+{
+    return event_flags->flags;
+}
+
+uint32_t OS_EventFlags_Wait(EventFlags_t *event_flags, uint32_t flags, uint32_t options)
+{
+    assert_or_panic(flags != 0);
+    uint32_t matched_flags;
+    OS_Critical_Enter();
+    if (OS_EventFlags_TryTake(event_flags, flags, options, &matched_flags))
+    {
+        OS_Critical_Exit();
+        return matched_flags;
+    }
+
+    RunPt->event_flags = flags;
+    RunPt->event_options = options;
+    event_flags->waited_flags |= flags;
+    OS_Thread_Block(&(event_flags->waiters), OS_NO_TIMEOUT);
+    OS_Critical_Exit();
+
+    /* OS_EventFlags_Set stored the matched flags, and cleared them if requested */
+    return RunPt->event_flags;
+}
+
+HAL_StatusTypeDef OS_EventFlags_WaitTimeout(EventFlags_t *event_flags, uint32_t flags, uint32_t options,
+                                            uint32_t *matched_flags, uint32_t timeout_ms)
+{
+    assert_or_panic(flags != 0);
+    OS_Critical_Enter();
+    if (OS_EventFlags_TryTake(event_flags, flags, options, matched_flags))
+    {
+        OS_Critical_Exit();
+        return HAL_OK;
+    }
+    if (timeout_ms == 0)
+    {
+        OS_Critical_Exit();
+        return HAL_TIMEOUT;
+    }
+
+    RunPt->event_flags = flags;
+    RunPt->event_options = options;
+    event_flags->waited_flags |= flags;
+    OS_Thread_Block(&(event_flags->waiters), timeout_ms);
+    OS_Critical_Exit();
+
+    if (RunPt->timed_out)
+    {
+        return HAL_TIMEOUT;
+    }
+    *matched_flags = RunPt->event_flags;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef OS_EventFlags_TryWait(EventFlags_t *event_flags, uint32_t flags, uint32_t options,
+                                        uint32_t *matched_flags)
+{
+    assert_or_panic(flags != 0);
+    OS_Critical_Enter();
+    bool is_taken = OS_EventFlags_TryTake(event_flags, flags, options, matched_flags);
+    OS_Critical_Exit();
+    return is_taken ? HAL_OK : HAL_BUSY;
+}
+
+static bool OS_EventFlags_IsSatisfied(uint32_t flags_set, uint32_t flags, uint32_t options)
+{
+    if (options & OS_EVENTFLAGS_WAIT_ALL)
+    {
+        return (flags_set & flags) == flags;
+    }
+    return (flags_set & flags) != 0;
+}
+
+static bool OS_EventFlags_TryTake(EventFlags_t *event_flags, uint32_t flags, uint32_t options,
+                                  uint32_t *matched_flags)
+{
+    if (!OS_EventFlags_IsSatisfied(event_flags->flags, flags, options))
+    {
+        return false;
+    }
+    *matched_flags = event_flags->flags & flags;
+    if (options & OS_EVENTFLAGS_CLEAR_ON_EXIT)
+    {
+        event_flags->flags &= ~flags;
     }
-    __enable_irq();
+    return true;
 }
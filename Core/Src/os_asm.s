@@ -1,28 +1,38 @@
 .syntax unified @ See https://sourceware.org/binutils/docs/as/ARM_002dInstruction_002dSet.html
 .cpu cortex-m4
-.fpu softvfp
+.fpu fpv4-sp-d16
 .thumb
 
+@ Only the config defines of os.h are visible to the assembler, see OS_USE_CCMRAM
+#include "os.h"
+
 @ The .global directive gives the symbols external linkage.
-@ For clarity, the fn OSAsm_ThreadSwitch is exported as TIM2_IRQHandler, so that the vector table
+@ For clarity, the fn OSAsm_ThreadSwitch is exported as PendSV_Handler, so that the vector table
 @   in startup.s doesn't need to be modified.
 .global OSAsm_Start
-.set TIM2_IRQHandler, OSAsm_ThreadSwitch
-.global TIM2_IRQHandler
+.set PendSV_Handler, OSAsm_ThreadSwitch
+.global PendSV_Handler
 
 .extern RunPt
-.extern SchedlTimer_ClearITFlag
 .extern OS_Scheduler
+.extern _estack
 
 .section    .text.OSAsm_Start
 .type	OSAsm_Start, %function
 OSAsm_Start:
     CPSID   I                       @ disable interrupts
+    LDR     R0, =_estack            @ R0 = &_estack;
+    MSR     MSP, R0                 @ MSP = R0;     // reset the main stack, from now on used by ISRs only
     LDR     R0, =RunPt              @ R0 = &RunPt;  // TCB_t**  R0 = &RunPt
     LDR     R1, [R0]                @ R1 = *R0;     // TCB_t*   R1 = RunPt
-    LDR     SP, [R1]                @ SP = *R1;     // uint32_t SP = *(RunPt.sp)
+    LDR     R2, [R1]                @ R2 = *R1;     // uint32_t R2 = *(RunPt.sp)
+    MSR     PSP, R2                 @ PSP = R2;
+    MOV     R0, #2                  @ threads run on the process stack (CONTROL.SPSEL = 1)
+    MSR     CONTROL, R0
+    ISB                             @ flush the pipeline, so that SP is PSP from now on
                                     @ now we switched to the thread's stack, which we populated before
     POP     {R4-R11}                @ pop regs R4-R11
+    POP     {R0}                    @ discard EXC_RETURN, the first thread starts without FP context
     POP     {R0-R3}                 @ pop regs R0-R3
     POP     {R12}                   @ pop reg  R12
     POP     {LR}                    @ discard LR
@@ -31,24 +41,41 @@ OSAsm_Start:
     CPSIE   I                       @ enable interrupts
     BX      LR                      @ start first thread
 
+#if OS_USE_CCMRAM
+.section    .ccmram.OSAsm_ThreadSwitch, "ax", %progbits
+#else
 .section    .text.OSAsm_ThreadSwitch
+#endif
 .type	OSAsm_ThreadSwitch, %function
 OSAsm_ThreadSwitch:
-                                    @ save R0-R3,R12,LR,PC,PSR
-    CPSID   I                       @ prevent interrupt during context-switch
-    PUSH    {R4-R11}                @ save remaining regs R4-R11
+                                    @ R0-R3,R12,LR,PC,PSR already saved on the thread's stack (PSP),
+                                    @ as well as S0-S15,FPSCR if the thread used the FPU (lazy stacking)
+    MOV     R0, #OS_KERNEL_BASEPRI  @ mask the ISRs that call kernel fns during context-switch,
+    CPSID   I                       @   CPSID/CPSIE work around the Cortex-M4 r0p1 erratum 837070
+    MSR     BASEPRI, R0             @ BASEPRI = OS_KERNEL_BASEPRI;
+    DSB
+    ISB
+    CPSIE   I
+    MRS     R2, PSP                 @ R2 = PSP;
+    TST     LR, #0x10               @ EXC_RETURN bit 4 is clear if the thread has an FP context
+    IT      EQ
+    VSTMDBEQ R2!, {S16-S31}         @ save regs S16-S31, this also completes the lazy stacking of S0-S15
+    STMDB   R2!, {R4-R11, LR}       @ save remaining regs R4-R11 and EXC_RETURN on the thread's stack
     LDR     R0, =RunPt              @ R0 = &RunPt;  // TCB_t** R0  = &RunPt
     LDR     R1, [R0]                @ R1 = *R0;     // TCB_t*  R1  = RunPt
-    STR     SP, [R1]                @ *R1 = SP;     // *(RunPt.sp) = SP
+    STR     R2, [R1]                @ *R1 = R2;     // *(RunPt.sp) = R2
 
-    PUSH    {R0, LR}                @ push R0 and LR, so that fn calls don't loose them
-    BL      SchedlTimer_ClearITFlag @ clear SchedlTimer interrupt flag
+    PUSH    {R0, LR}                @ push R0 and LR on the main stack, so that fn calls don't loose them
     BL      OS_Scheduler            @ call OS_Scheduler, RunPt is updated
     POP     {R0, LR}                @ restore R0 and LR
 
     LDR     R1, [R0]                @ R1 = *R0;     // TCB_t*   R1 = RunPt
-    LDR     SP, [R1]                @ SP = *R1;     // uint32_t SP = *(RunPt.sp)
-                                    @ now we switched to the new thread's stack
-    POP     {R4-R11}                @ restore regs R4-R11
-    CPSIE   I                       @ tasks run with interrupts enabled
-    BX      LR                      @ restore R0-R3,R12,LR,PC,PSR
+    LDR     R2, [R1]                @ R2 = *R1;     // uint32_t R2 = *(RunPt.sp)
+    LDMIA   R2!, {R4-R11, LR}       @ restore regs R4-R11 and EXC_RETURN from the new thread's stack
+    TST     LR, #0x10               @ restore regs S16-S31 only if the new thread has an FP context
+    IT      EQ
+    VLDMIAEQ R2!, {S16-S31}
+    MSR     PSP, R2                 @ PSP = R2;     // now we switched to the new thread's stack
+    MOV     R0, #0                  @ tasks run with interrupts enabled
+    MSR     BASEPRI, R0             @ BASEPRI = 0;
+    BX      LR                      @ restore R0-R3,R12,LR,PC,PSR (and S0-S15,FPSCR)
@@ -53,17 +53,15 @@ void SchedlTimer_Start(void)
     IFERR_PANIC(HAL_TIM_Base_Start_IT(&TIMHandle));
 }
 
-void SchedlTimer_ClearITFlag(void)
+void SchedlTimer_Stop(void)
 {
-    __HAL_TIM_CLEAR_IT(&TIMHandle, TIM_IT_UPDATE);
-    InstrumentTriggerPB0_Toggle();
+    IFERR_PANIC(HAL_TIM_Base_Stop_IT(&TIMHandle));
 }
 
-void SchedlTimer_ResetCounter(void)
+void SchedlTimer_ClearITFlag(void)
 {
-    __HAL_TIM_SET_COUNTER(&TIMHandle, 0);
-    /* Don't return from this fn before the interrupt triggered */
-    HAL_Delay(1);
+    __HAL_TIM_CLEAR_IT(&TIMHandle, TIM_IT_UPDATE);
+    InstrumentTriggerPB0_Toggle();
 }
 
 //==================================================================================================
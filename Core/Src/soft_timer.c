@@ -0,0 +1,239 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "soft_timer.h"
+
+#include "iferr.h"
+
+#include "stm32f3xx_hal.h"
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+typedef enum
+{
+    SoftTimerCommandStart, /* Arm the timer, unless it's already armed */
+    SoftTimerCommandStop,  /* Disarm the timer */
+    SoftTimerCommandReset  /* Arm the timer again, from the tick the command was issued at */
+} SoftTimerCommandType_t;
+
+typedef struct
+{
+    SoftTimer_t *timer;
+    SoftTimerCommandType_t type;
+    uint32_t tick; /* HAL tick at which the command was issued */
+} SoftTimerCommand_t;
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+/**
+ * The fn SoftTimer_SendCommand appends a command to the queue and notifies the daemon.
+ * It returns HAL_BUSY if the queue is full.
+ * The fn SoftTimer_ReceiveCommand pops the oldest command from the queue, it returns false if the queue is empty.
+ */
+static HAL_StatusTypeDef SoftTimer_SendCommand(SoftTimer_t *timer, SoftTimerCommandType_t type);
+static bool SoftTimer_ReceiveCommand(SoftTimerCommand_t *command);
+
+/**
+ * The fn SoftTimer_ProcessCommands applies the queued commands to the list of armed timers.
+ * The fn SoftTimer_ProcessExpired runs the callbacks of the expired timers, re-arming the auto-reload ones.
+ * They're run by the daemon thread only.
+ */
+static void SoftTimer_ProcessCommands(void);
+static void SoftTimer_ProcessExpired(void);
+
+/**
+ * The fn SoftTimer_Insert adds the timer to the list of armed timers, after the ones expiring earlier
+ * or at the same time. The fn SoftTimer_Remove unlinks it.
+ * Ticks are compared through their signed difference, so that the HAL tick can wrap around.
+ */
+static void SoftTimer_Insert(SoftTimer_t *timer);
+static void SoftTimer_Remove(SoftTimer_t *timer);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+/* Armed timers, ordered by expiry time, owned by the daemon thread */
+static SoftTimer_t *ActiveTimers;
+
+/* Commands issued by threads and ISRs, waiting to be processed by the daemon */
+static SoftTimerCommand_t Commands[SOFTTIMER_QUEUE_SIZE];
+static uint32_t CommandsHead;
+static uint32_t CommandsCount;
+
+/* Handle of the daemon thread, NULL until it runs */
+static ThreadHandle_t DaemonTask;
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void SoftTimer_Init(SoftTimer_t *timer, void (*callback)(void *arg), void *arg, uint32_t period_ms,
+                    SoftTimerMode_t mode)
+{
+    assert_or_panic(callback != NULL && period_ms > 0);
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->period_ms = period_ms;
+    timer->mode = mode;
+    timer->expiry_tick = 0;
+    timer->is_active = false;
+    timer->next = NULL;
+}
+
+HAL_StatusTypeDef SoftTimer_Start(SoftTimer_t *timer)
+{
+    return SoftTimer_SendCommand(timer, SoftTimerCommandStart);
+}
+
+HAL_StatusTypeDef SoftTimer_Stop(SoftTimer_t *timer)
+{
+    return SoftTimer_SendCommand(timer, SoftTimerCommandStop);
+}
+
+HAL_StatusTypeDef SoftTimer_Reset(SoftTimer_t *timer)
+{
+    return SoftTimer_SendCommand(timer, SoftTimerCommandReset);
+}
+
+void SoftTimer_DaemonTask(void)
+{
+    /* Commands sent before the handle is known are processed right after */
+    OS_Critical_Enter();
+    DaemonTask = OS_Thread_GetCurrent();
+    OS_Critical_Exit();
+
+    while (1)
+    {
+        SoftTimer_ProcessCommands();
+        SoftTimer_ProcessExpired();
+
+        /* A command sent in the meantime left a notification pending, so the wait returns right away */
+        if (ActiveTimers == NULL)
+        {
+            OS_Thread_NotifyWait(UINT32_MAX);
+            continue;
+        }
+        int32_t remaining_ms = (int32_t)(ActiveTimers->expiry_tick - HAL_GetTick());
+        if (remaining_ms > 0)
+        {
+            uint32_t notify_value;
+            (void)OS_Thread_NotifyWaitTimeout(UINT32_MAX, &notify_value, (uint32_t)remaining_ms);
+        }
+    }
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static HAL_StatusTypeDef SoftTimer_SendCommand(SoftTimer_t *timer, SoftTimerCommandType_t type)
+{
+    OS_Critical_Enter();
+    if (CommandsCount == SOFTTIMER_QUEUE_SIZE)
+    {
+        OS_Critical_Exit();
+        return HAL_BUSY;
+    }
+    Commands[(CommandsHead + CommandsCount) % SOFTTIMER_QUEUE_SIZE] = (SoftTimerCommand_t){
+        .timer = timer,
+        .type = type,
+        .tick = HAL_GetTick(),
+    };
+    CommandsCount++;
+    ThreadHandle_t daemon_task = DaemonTask;
+    OS_Critical_Exit();
+
+    if (daemon_task != NULL)
+    {
+        OS_Thread_NotifyGive(daemon_task);
+    }
+    return HAL_OK;
+}
+
+static bool SoftTimer_ReceiveCommand(SoftTimerCommand_t *command)
+{
+    OS_Critical_Enter();
+    if (CommandsCount == 0)
+    {
+        OS_Critical_Exit();
+        return false;
+    }
+    *command = Commands[CommandsHead];
+    CommandsHead = (CommandsHead + 1) % SOFTTIMER_QUEUE_SIZE;
+    CommandsCount--;
+    OS_Critical_Exit();
+    return true;
+}
+
+static void SoftTimer_ProcessCommands(void)
+{
+    SoftTimerCommand_t command;
+    while (SoftTimer_ReceiveCommand(&command))
+    {
+        SoftTimer_t *timer = command.timer;
+        if ((command.type == SoftTimerCommandStart) && timer->is_active)
+        {
+            continue;
+        }
+        if (timer->is_active)
+        {
+            SoftTimer_Remove(timer);
+        }
+        if (command.type != SoftTimerCommandStop)
+        {
+            timer->expiry_tick = command.tick + timer->period_ms;
+            SoftTimer_Insert(timer);
+        }
+    }
+}
+
+static void SoftTimer_ProcessExpired(void)
+{
+    while ((ActiveTimers != NULL) && ((int32_t)(ActiveTimers->expiry_tick - HAL_GetTick()) <= 0))
+    {
+        SoftTimer_t *timer = ActiveTimers;
+        SoftTimer_Remove(timer);
+
+        /* Re-armed before the callback runs, so that the callback can stop it */
+        if (timer->mode == SoftTimerModeAutoReload)
+        {
+            timer->expiry_tick += timer->period_ms;
+            SoftTimer_Insert(timer);
+        }
+        timer->callback(timer->arg);
+    }
+}
+
+static void SoftTimer_Insert(SoftTimer_t *timer)
+{
+    SoftTimer_t **link = &ActiveTimers;
+    while ((*link != NULL) && ((int32_t)((*link)->expiry_tick - timer->expiry_tick) <= 0))
+    {
+        link = &((*link)->next);
+    }
+    timer->next = *link;
+    *link = timer;
+    timer->is_active = true;
+}
+
+static void SoftTimer_Remove(SoftTimer_t *timer)
+{
+    SoftTimer_t **link = &ActiveTimers;
+    while (*link != timer)
+    {
+        link = &((*link)->next);
+    }
+    *link = timer->next;
+    timer->next = NULL;
+    timer->is_active = false;
+}
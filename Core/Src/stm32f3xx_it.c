@@ -6,6 +6,7 @@
 
 #include "onboard_user_button.h"
 #include "os.h"
+#include "user_tasks.h"
 
 #include "core_cm4.h"
 #include "stm32f3xx_hal.h"
@@ -89,6 +90,12 @@ void HardFault_Handler(void)
 
 void MemManage_Handler(void)
 {
+#if OS_STACK_OVERFLOW_CHECK == OS_STACK_OVERFLOW_CHECK_MPU
+    /* Most likely the running thread hit the guard region at the bottom of its stack: its name is recorded
+     * in OverflowedThreadName (os.c). The fault status is in HardFaultStatusRegs, as for HardFault_Handler */
+    OS_Stack_RecordOverflow();
+#endif
+    InspectHardFault();
     while (1)
     {
     }
@@ -116,14 +123,10 @@ void DebugMon_Handler(void)
 {
 }
 
-void PendSV_Handler(void)
-{
-}
-
 void SysTick_Handler(void)
 {
     HAL_IncTick();
-    OS_DecrementTCBsSleepDuration();
+    OS_Tick();
 }
 
 //==================================================================================================
@@ -132,11 +135,27 @@ void SysTick_Handler(void)
 // please refer to the startup file (startup_stm32f3xx.s).
 //==================================================================================================
 
+void SchedlTimer_IRQHandler(void)
+{
+    SchedlTimer_ClearITFlag();
+    OS_Scheduler_Invoke();
+}
+
 void EXTI0_IRQHandler(void)
 {
     OnboardUserButton_IRQHandler();
 }
 
+void EXTI1_IRQHandler(void)
+{
+    UserTask_WakeupBenchmarkIRQHandler();
+}
+
+void TIM7_IRQHandler(void)
+{
+    UserTask_InterruptLatencyBenchmarkIRQHandler();
+}
+
 //==================================================================================================
 // STATIC FUNCTIONS
 //==================================================================================================
@@ -0,0 +1,106 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "tick_timer.h"
+
+#include "stm32f3xx_hal.h"
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+/* SysTick cycles in one tick, as configured by the HAL */
+static uint32_t CyclesPerTick;
+
+/* Number of ticks and SysTick reload value programmed by TickTimer_Suppress */
+static uint32_t SuppressedTicks;
+static uint32_t OneShotReload;
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+bool TickTimer_Suppress(uint32_t idle_ticks)
+{
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        return false;
+    }
+
+    CyclesPerTick = SysTick->LOAD + 1;
+    uint32_t max_ticks = SysTick_LOAD_RELOAD_Msk / CyclesPerTick;
+    if (idle_ticks > max_ticks)
+    {
+        idle_ticks = max_ticks;
+    }
+
+    /* The counter keeps the cycles left in the current tick, the suppressed ticks are added on top */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    OneShotReload = SysTick->VAL + (idle_ticks - 1) * CyclesPerTick;
+    SuppressedTicks = idle_ticks;
+
+    SysTick->LOAD = OneShotReload;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    return true;
+}
+
+uint32_t TickTimer_Resume(void)
+{
+    /* Reading CTRL clears COUNTFLAG, so it's read only once */
+    uint32_t ctrl = SysTick->CTRL;
+    SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+
+    uint32_t elapsed_ticks;
+    uint32_t cycles_left_in_tick;
+    if (ctrl & SysTick_CTRL_COUNTFLAG_Msk)
+    {
+        /* The one-shot timer expired, and the counter restarted from OneShotReload */
+        uint32_t cycles_since_expiry = OneShotReload - SysTick->VAL;
+        cycles_left_in_tick = CyclesPerTick;
+        if (cycles_since_expiry < CyclesPerTick)
+        {
+            cycles_left_in_tick = CyclesPerTick - cycles_since_expiry;
+        }
+        elapsed_ticks = SuppressedTicks - 1;
+    }
+    else
+    {
+        /* Another interrupt woke the CPU up before the one-shot timer expired */
+        uint32_t cycles_elapsed = SuppressedTicks * CyclesPerTick - SysTick->VAL;
+        elapsed_ticks = cycles_elapsed / CyclesPerTick;
+        cycles_left_in_tick = (elapsed_ticks + 1) * CyclesPerTick - cycles_elapsed;
+    }
+
+    /* A reload value of zero would never trigger the interrupt */
+    if (cycles_left_in_tick < 2)
+    {
+        cycles_left_in_tick = 2;
+    }
+
+    /* Complete the current tick, then go back to periodic mode */
+    SysTick->LOAD = cycles_left_in_tick - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = CyclesPerTick - 1;
+
+    uwTick += elapsed_ticks * uwTickFreq;
+    return elapsed_ticks;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
@@ -0,0 +1,195 @@
+//==================================================================================================
+// INCLUDES
+//==================================================================================================
+
+#include "timing_wheel.h"
+
+#include "iferr.h"
+
+#include "stm32f3xx_hal.h"
+
+//==================================================================================================
+// DEFINES - MACROS
+//==================================================================================================
+
+#define TIMINGWHEEL_SLOT_MASK (TIMINGWHEEL_SLOTS - 1)
+
+/* The bitmaps are stored MSB-first, so that CLZ returns the distance to the next non-empty slot directly */
+#define TIMINGWHEEL_SLOT_BIT(slot) (0x80000000U >> (slot))
+
+//==================================================================================================
+// ENUMS - STRUCTS - TYPEDEFS
+//==================================================================================================
+
+//==================================================================================================
+// STATIC PROTOTYPES
+//==================================================================================================
+
+/**
+ * The fn TimingWheel_Place links the entry to the slot matching its expiry, relative to the wheel's now:
+ * the level is given by the highest bit set in the distance, the slot by the expiry's bits at that level.
+ */
+static void TimingWheel_Place(TimingWheel_t *wheel, TimingWheelEntry_t *entry);
+
+/**
+ * The fn TimingWheel_Cascade empties the slot, placing its entries again, on lower levels, relative to the wheel's now.
+ */
+static void TimingWheel_Cascade(TimingWheel_t *wheel, uint32_t level, uint32_t slot);
+
+//==================================================================================================
+// STATIC VARIABLES
+//==================================================================================================
+
+//==================================================================================================
+// GLOBAL FUNCTIONS
+//==================================================================================================
+
+void TimingWheel_Init(TimingWheel_t *wheel)
+{
+    for (uint32_t level = 0; level < TIMINGWHEEL_LEVELS; level++)
+    {
+        for (uint32_t slot = 0; slot < TIMINGWHEEL_SLOTS; slot++)
+        {
+            wheel->slots[level][slot] = NULL;
+        }
+        wheel->bitmaps[level] = 0;
+    }
+    wheel->now = 0;
+}
+
+void TimingWheel_Insert(TimingWheel_t *wheel, TimingWheelEntry_t *entry, uint32_t ticks)
+{
+    assert_or_panic(entry->link == NULL);
+    if (ticks == 0)
+    {
+        ticks = 1;
+    }
+    if (ticks > TIMINGWHEEL_MAX_TICKS)
+    {
+        ticks = TIMINGWHEEL_MAX_TICKS;
+    }
+    entry->expiry = wheel->now + ticks - 1;
+    TimingWheel_Place(wheel, entry);
+}
+
+void TimingWheel_Remove(TimingWheel_t *wheel, TimingWheelEntry_t *entry)
+{
+    TimingWheelEntry_t **link = entry->link;
+    *link = entry->next;
+    if (entry->next != NULL)
+    {
+        entry->next->link = link;
+    }
+    entry->next = NULL;
+    entry->link = NULL;
+
+    /* The entry was the last one of its slot, unless it was in the middle of a list or in a list of expired ones */
+    TimingWheelEntry_t **first_slot = &(wheel->slots[0][0]);
+    if ((*link == NULL) && (link >= first_slot) && (link < first_slot + TIMINGWHEEL_LEVELS * TIMINGWHEEL_SLOTS))
+    {
+        uint32_t slot_idx = (uint32_t)(link - first_slot);
+        wheel->bitmaps[slot_idx / TIMINGWHEEL_SLOTS] &= ~TIMINGWHEEL_SLOT_BIT(slot_idx % TIMINGWHEEL_SLOTS);
+    }
+}
+
+bool TimingWheel_IsArmed(const TimingWheelEntry_t *entry)
+{
+    return entry->link != NULL;
+}
+
+void TimingWheel_Tick(TimingWheel_t *wheel, TimingWheelEntry_t **expired)
+{
+    assert_or_panic(*expired == NULL);
+    uint32_t tick = wheel->now;
+    uint32_t slot = tick & TIMINGWHEEL_SLOT_MASK;
+
+    /* When a level wraps around, the current slot of the level above is due */
+    if (slot == 0)
+    {
+        for (uint32_t level = 1; level < TIMINGWHEEL_LEVELS; level++)
+        {
+            uint32_t level_slot = (tick >> (level * TIMINGWHEEL_SLOT_BITS)) & TIMINGWHEEL_SLOT_MASK;
+            TimingWheel_Cascade(wheel, level, level_slot);
+            if (level_slot != 0)
+            {
+                break;
+            }
+        }
+    }
+    wheel->now = tick + 1;
+
+    TimingWheelEntry_t *first = wheel->slots[0][slot];
+    if (first != NULL)
+    {
+        wheel->slots[0][slot] = NULL;
+        wheel->bitmaps[0] &= ~TIMINGWHEEL_SLOT_BIT(slot);
+        first->link = expired;
+        *expired = first;
+    }
+}
+
+uint32_t TimingWheel_GetIdleTicks(const TimingWheel_t *wheel)
+{
+    uint32_t idle_ticks = UINT32_MAX;
+    for (uint32_t level = 0; level < TIMINGWHEEL_LEVELS; level++)
+    {
+        if (wheel->bitmaps[level] == 0)
+        {
+            continue;
+        }
+        /* The level is processed on the ticks that are multiples of its slot's width,
+         * the first one at or after now processes the slot slot_idx */
+        uint32_t shift = level * TIMINGWHEEL_SLOT_BITS;
+        uint32_t width_mask = (1U << shift) - 1;
+        uint32_t first_tick = (wheel->now + width_mask) & ~width_mask;
+        uint32_t slot_idx = (first_tick >> shift) & TIMINGWHEEL_SLOT_MASK;
+
+        /* Rotating the bitmap left by slot_idx brings that slot to the MSB */
+        uint32_t distance = __CLZ(__ROR(wheel->bitmaps[level], TIMINGWHEEL_SLOTS - slot_idx));
+        uint32_t level_idle_ticks = first_tick + (distance << shift) - wheel->now + 1;
+        if (level_idle_ticks < idle_ticks)
+        {
+            idle_ticks = level_idle_ticks;
+        }
+    }
+    return idle_ticks;
+}
+
+void TimingWheel_Skip(TimingWheel_t *wheel, uint32_t ticks)
+{
+    wheel->now += ticks;
+}
+
+//==================================================================================================
+// STATIC FUNCTIONS
+//==================================================================================================
+
+static void TimingWheel_Place(TimingWheel_t *wheel, TimingWheelEntry_t *entry)
+{
+    uint32_t distance = entry->expiry - wheel->now;
+    uint32_t level = (31 - __CLZ(distance | 1)) / TIMINGWHEEL_SLOT_BITS;
+    uint32_t slot = (entry->expiry >> (level * TIMINGWHEEL_SLOT_BITS)) & TIMINGWHEEL_SLOT_MASK;
+
+    TimingWheelEntry_t **link = &(wheel->slots[level][slot]);
+    entry->next = *link;
+    entry->link = link;
+    if (*link != NULL)
+    {
+        (*link)->link = &(entry->next);
+    }
+    *link = entry;
+    wheel->bitmaps[level] |= TIMINGWHEEL_SLOT_BIT(slot);
+}
+
+static void TimingWheel_Cascade(TimingWheel_t *wheel, uint32_t level, uint32_t slot)
+{
+    TimingWheelEntry_t *entry = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    wheel->bitmaps[level] &= ~TIMINGWHEEL_SLOT_BIT(slot);
+    while (entry != NULL)
+    {
+        TimingWheelEntry_t *next = entry->next;
+        TimingWheel_Place(wheel, entry);
+        entry = next;
+    }
+}
@@ -4,8 +4,12 @@
 
 #include "user_tasks.h"
 
+#include "fifo_queue.h"
+#include "iferr.h"
 #include "instrument_trigger.h"
 #include "os.h"
+#include "schedl_timer.h"
+#include "stm32f3xx_it.h"
 
 #include "stm32f3xx_hal.h"
 #include <stdint.h>
@@ -20,18 +24,207 @@ InstrumentTrigger_Create(E, 12); /* UserTask_1 */
 InstrumentTrigger_Create(E, 13); /* UserTask_2 */
 InstrumentTrigger_Create(E, 14); /* UserTask_3 */
 
+#define FIFOBENCHMARK_NUM_ITEMS 640 /* Items moved through the FIFO for each batch size */
+#define FIFOBENCHMARK_NUM_BATCHES 3
+
+#define WAKEUPBENCHMARK_NUM_WAKEUPS 100 /* Wake-ups measured for each path */
+
+#define TIMINGWHEELBENCHMARK_NUM_TICKS 4096 /* Ticks measured for each number of armed timeouts */
+#define TIMINGWHEELBENCHMARK_MAX_TICKS 4096 /* Timeouts are armed for 1 to 4096 ticks, spanning three levels */
+#define TIMINGWHEELBENCHMARK_NUM_COUNTS 3
+#define TIMINGWHEELBENCHMARK_MAX_ENTRIES 1000
+
+#define SCHEDULERBENCHMARK_NUM_RUNS 100 /* Runs measured for each number of threads */
+#define SCHEDULERBENCHMARK_NUM_COUNTS 3
+#define SCHEDULERBENCHMARK_MAX_THREADS 64
+
+#define SLEEPTEST_NUM_DURATIONS 6
+#define SLEEPTEST_NUM_ROUNDS 10 /* Sleeps checked for each duration */
+
+#define CONTEXTSWITCHBENCHMARK_NUM_SWITCHES 200 /* Switches measured for each kind of thread */
+#define CONTEXTSWITCHBENCHMARK_DMA_WORDS 0xFFFF  /* Words moved by each DMA transfer, the most CNDTR allows */
+
+#define PRIORITYINVERSIONTEST_CS_MS 5               /* Length of the critical sections of the low priority threads */
+#define PRIORITYINVERSIONTEST_HOG_FACTOR 5          /* The hog runs for that many critical sections */
+#define PRIORITYINVERSIONTEST_MARGIN_PERCENT 10     /* Share of a critical section allowed for the kernel's overhead */
+#define PRIORITYINVERSIONTEST_CALIBRATION_ITERATIONS 10000
+
+#define INTERRUPTLATENCYBENCHMARK_FREQUENCY_HZ 10000 /* Rate of the TIM7 update interrupts */
+#define INTERRUPTLATENCYBENCHMARK_DURATION_MS 1000   /* Duration of each measurement */
+#define INTERRUPTLATENCYBENCHMARK_ZERO_LATENCY_PRIORITY (OS_KERNEL_IRQ_PRIORITY - 1)
+
 //==================================================================================================
 // ENUMS - STRUCTS - TYPEDEFS
 //==================================================================================================
 
+/**
+ * The type SchedulerBenchmarkTCB_t mirrors the fields the original scheduler looked at, for
+ * SchedulerBenchmark_LinearScan to walk a ring of any length.
+ */
+typedef struct SchedulerBenchmarkTCB
+{
+    struct SchedulerBenchmarkTCB *next;
+    uint32_t sleep;
+    void *blocked;
+    uint8_t priority;
+} SchedulerBenchmarkTCB_t;
+
 //==================================================================================================
 // STATIC PROTOTYPES
 //==================================================================================================
 
+/**
+ * The fns WakeupBenchmark_SemaphoreWaiter and WakeupBenchmark_NotifyWaiter are run by UserTask_WakeupBenchmark
+ * with the highest priority. They block on the semaphore, or wait for a notification, and accumulate the
+ * cycles elapsed since the benchmark started waking them up, then kill themselves.
+ */
+static void WakeupBenchmark_SemaphoreWaiter(void);
+static void WakeupBenchmark_NotifyWaiter(void);
+
+/**
+ * The fn TimingWheelBenchmark_Random returns a pseudo-random timeout, between 1 and TIMINGWHEELBENCHMARK_MAX_TICKS.
+ * The fn TimingWheelBenchmark_Rearm is the callback of the benchmark's timeouts: it starts the timeout again,
+ * so that the number of armed timeouts stays the same.
+ */
+static uint32_t TimingWheelBenchmark_Random(void);
+static void TimingWheelBenchmark_Rearm(void *arg);
+
+/**
+ * The fn SchedulerBenchmark_Filler is run by the threads UserTask_SchedulerBenchmark creates to fill the ready lists.
+ * They only run once the benchmark is over, and kill themselves.
+ * The fn SchedulerBenchmark_LinearScan is the scheduler the bitmap-indexed ready lists replaced: it walks
+ * the whole ring of TCBs, looking for the highest priority one that is neither sleeping nor blocked.
+ */
+static void SchedulerBenchmark_Filler(void);
+static SchedulerBenchmarkTCB_t *SchedulerBenchmark_LinearScan(SchedulerBenchmarkTCB_t *run_pt);
+
+/**
+ * The fn ContextSwitchBenchmark_Run creates two workers with the same priority, below the calling thread's,
+ * waits until they have switched to each other CONTEXTSWITCHBENCHMARK_NUM_SWITCHES times, and returns the
+ * average cycles per switch. With use_fpu set, the workers use the FPU before each switch; with use_dma set,
+ * DMA1 channel 1 keeps copying between two words of SRAM meanwhile, loading the bus matrix.
+ * The fn ContextSwitchBenchmark_Worker is run by the workers: it yields to the other worker and, once
+ * it's scheduled again, accumulates the cycles elapsed since the other one yielded.
+ * The fn ContextSwitchBenchmark_ArmDMA starts a memory-to-memory transfer of CONTEXTSWITCHBENCHMARK_DMA_WORDS words.
+ */
+static uint32_t ContextSwitchBenchmark_Run(bool use_fpu, bool use_dma);
+static void ContextSwitchBenchmark_Worker(void);
+static void ContextSwitchBenchmark_ArmDMA(void);
+
+/**
+ * The fn PriorityInversionTest_Work keeps the CPU busy for iterations loop iterations, which take the same
+ * number of cycles whether the thread is preempted or not, unlike a busy wait on the cycle counter.
+ * The fn PriorityInversionTest_WaitWorkers waits until count workers are done, and lets the last one kill itself.
+ */
+static void PriorityInversionTest_Work(uint32_t iterations);
+static void PriorityInversionTest_WaitWorkers(uint32_t count);
+
+/**
+ * The fns PriorityInversionTest_High, _Hog, _Chain and _Low are run by the workers, from the highest priority
+ * to the lowest. Low holds PriorityInversionTestLowMutex for a critical section; Chain, woken after 1 ms, locks
+ * mutex A then mutex B for a critical section; Hog, woken after 2 ms, keeps the CPU for
+ * PRIORITYINVERSIONTEST_HOG_FACTOR critical sections; High, woken after 3 ms, locks mutex A and measures
+ * how long it's blocked.
+ */
+static void PriorityInversionTest_High(void);
+static void PriorityInversionTest_Hog(void);
+static void PriorityInversionTest_Chain(void);
+static void PriorityInversionTest_Low(void);
+
+/**
+ * The fn InterruptLatencyBenchmark_Run lets the TIM7 update interrupt fire, with the given preemption priority,
+ * while the ping and pong threads keep entering the kernel, and returns the worst latency measured, in cycles.
+ * The fns InterruptLatencyBenchmark_Ping and _Pong wake up each other through two semaphores, until
+ * InterruptLatencyBenchmarkIsStopping is set.
+ */
+static uint32_t InterruptLatencyBenchmark_Run(uint32_t irq_priority);
+static void InterruptLatencyBenchmark_Ping(void);
+static void InterruptLatencyBenchmark_Pong(void);
+
 //==================================================================================================
 // STATIC VARIABLES
 //==================================================================================================
 
+/* Results of UserTask_FifoBenchmark, to be inspected with the debugger */
+static const uint32_t FifoBenchmarkBatchSizes[FIFOBENCHMARK_NUM_BATCHES] = {1, 8, FIFOQUEUE_SIZE};
+static uint32_t FifoBenchmarkCyclesPerItem[FIFOBENCHMARK_NUM_BATCHES];
+
+/* Results of UserTask_WakeupBenchmark, to be inspected with the debugger */
+static uint32_t WakeupBenchmarkSemaphoreCycles;
+static uint32_t WakeupBenchmarkNotifyCycles;
+static uint32_t WakeupBenchmarkISRCycles;
+
+/* State shared by UserTask_WakeupBenchmark and the waiters */
+static Semaphore_t WakeupBenchmarkSemaphore;
+static uint32_t WakeupBenchmarkStartCycles;
+static uint32_t WakeupBenchmarkTotalCycles;
+
+/* Results of UserTask_TimingWheelBenchmark, to be inspected with the debugger */
+static const uint32_t TimingWheelBenchmarkCounts[TIMINGWHEELBENCHMARK_NUM_COUNTS] = {10, 100, 1000};
+static uint32_t TimingWheelBenchmarkAverageCycles[TIMINGWHEELBENCHMARK_NUM_COUNTS];
+static uint32_t TimingWheelBenchmarkMaxCycles[TIMINGWHEELBENCHMARK_NUM_COUNTS];
+
+/* State of TimingWheelBenchmark_Random */
+static uint32_t TimingWheelBenchmarkSeed = 1;
+
+/* Results of UserTask_SchedulerBenchmark, to be inspected with the debugger.
+ * OS_Scheduler can't be measured with more threads than MAXNUMTHREADS, those results are left at zero */
+static const uint32_t SchedulerBenchmarkCounts[SCHEDULERBENCHMARK_NUM_COUNTS] = {4, 10, 64};
+static uint32_t SchedulerBenchmarkBitmapCycles[SCHEDULERBENCHMARK_NUM_COUNTS];
+static uint32_t SchedulerBenchmarkLinearCycles[SCHEDULERBENCHMARK_NUM_COUNTS];
+
+/* Ring of TCBs walked by SchedulerBenchmark_LinearScan, and the TCB it picked, so that it's not optimized out */
+static SchedulerBenchmarkTCB_t SchedulerBenchmarkTCBs[SCHEDULERBENCHMARK_MAX_THREADS];
+static SchedulerBenchmarkTCB_t *volatile SchedulerBenchmarkBestPt;
+
+/* Durations checked by UserTask_SleepTest and the longest sleep measured for each, to be inspected with the debugger */
+static const uint32_t SleepTestDurationsMs[SLEEPTEST_NUM_DURATIONS] = {1, 2, 5, 17, 100, 1000};
+static uint32_t SleepTestMaxElapsedMs[SLEEPTEST_NUM_DURATIONS];
+
+/* Results of UserTask_ContextSwitchBenchmark, to be inspected with the debugger */
+static uint32_t ContextSwitchBenchmarkCycles;
+static uint32_t ContextSwitchBenchmarkFPCycles;
+static uint32_t ContextSwitchBenchmarkDMACycles;
+static uint32_t ContextSwitchBenchmarkDMAFPCycles;
+
+/* State shared by UserTask_ContextSwitchBenchmark and the workers. ContextSwitchBenchmarkIsStarted is set
+ * while ContextSwitchBenchmarkStartCycles holds the cycle count at which the last worker yielded */
+static Semaphore_t ContextSwitchBenchmarkDone;
+static bool ContextSwitchBenchmarkUseFPU;
+static bool ContextSwitchBenchmarkUseDMA;
+static uint32_t ContextSwitchBenchmarkDMASource;
+static uint32_t ContextSwitchBenchmarkDMADestination;
+static volatile float ContextSwitchBenchmarkFloat = 1.0f;
+static uint32_t ContextSwitchBenchmarkStartCycles;
+static bool ContextSwitchBenchmarkIsStarted;
+static uint32_t ContextSwitchBenchmarkTotalCycles;
+static uint32_t ContextSwitchBenchmarkCount;
+
+/* Results of UserTask_PriorityInversionTest, to be inspected with the debugger */
+static uint32_t PriorityInversionTestCSCycles;
+static uint32_t PriorityInversionTestBlockingCycles;
+static uint32_t PriorityInversionTestChainedBlockingCycles;
+
+/* State shared by UserTask_PriorityInversionTest and the workers */
+static Mutex_t PriorityInversionTestMutexA;
+static Mutex_t PriorityInversionTestMutexB;
+static Mutex_t *PriorityInversionTestLowMutex;
+static Semaphore_t PriorityInversionTestDone;
+static uint32_t PriorityInversionTestCSIterations;
+static uint32_t PriorityInversionTestHighBlockingCycles;
+
+/* Results of UserTask_InterruptLatencyBenchmark, to be inspected with the debugger */
+static uint32_t InterruptLatencyBenchmarkZeroLatencyCycles;
+static uint32_t InterruptLatencyBenchmarkMaskedCycles;
+
+/* State shared by UserTask_InterruptLatencyBenchmark, its ISR and the ping and pong threads */
+static Semaphore_t InterruptLatencyBenchmarkPing;
+static Semaphore_t InterruptLatencyBenchmarkPong;
+static Semaphore_t InterruptLatencyBenchmarkDone;
+static volatile bool InterruptLatencyBenchmarkIsStopping;
+static volatile uint32_t InterruptLatencyBenchmarkMaxTicks;
+static volatile uint32_t InterruptLatencyBenchmarkCount;
+
 //==================================================================================================
 // GLOBAL FUNCTIONS
 //==================================================================================================
@@ -47,7 +240,7 @@ void UserTask_0(void)
         count++;
         if (count == 100)
         {
-            OS_Thread_Create(UserTask_3, OS_SCHEDL_PRIO_MAIN_THREAD, "UserTask_3");
+            OS_Thread_Create(UserTask_3, OS_SCHEDL_PRIO_MAIN_THREAD, "UserTask_3", STACKSIZE);
         }
         if (count == 200)
         {
@@ -96,6 +289,517 @@ void UserTask_3(void)
     }
 }
 
+void UserTask_FifoBenchmark(void)
+{
+    static FifoQueue_t fifo;
+    static uint32_t items[FIFOQUEUE_SIZE];
+    FifoQueue_Init(&fifo);
+
+    for (uint32_t batch_idx = 0; batch_idx < FIFOBENCHMARK_NUM_BATCHES; batch_idx++)
+    {
+        /* The FIFO starts empty, so each PutN moves the whole batch, and GetN takes it all back */
+        uint32_t moved_count = 0;
+        uint32_t start_cycles = DWT->CYCCNT;
+        while (moved_count < FIFOBENCHMARK_NUM_ITEMS)
+        {
+            uint32_t batch_count = FifoQueue_PutN(&fifo, items, FifoBenchmarkBatchSizes[batch_idx]);
+            FifoQueue_GetN(&fifo, items, batch_count);
+            moved_count += batch_count;
+        }
+        FifoBenchmarkCyclesPerItem[batch_idx] = (DWT->CYCCNT - start_cycles) / moved_count;
+    }
+    OS_Thread_Kill();
+}
+
+void UserTask_WakeupBenchmark(void)
+{
+    /* Each wake-up switches to the waiter right away, which records the cycles before blocking again */
+    OS_Semaphore_Init(&WakeupBenchmarkSemaphore, 0);
+    WakeupBenchmarkTotalCycles = 0;
+    OS_Thread_Create(WakeupBenchmark_SemaphoreWaiter, OS_SCHEDL_PRIO_MAX, "SemaphoreWaiter", OS_STACKSIZE_MIN);
+    for (uint32_t idx = 0; idx < WAKEUPBENCHMARK_NUM_WAKEUPS; idx++)
+    {
+        WakeupBenchmarkStartCycles = DWT->CYCCNT;
+        OS_Semaphore_Signal(&WakeupBenchmarkSemaphore);
+    }
+    WakeupBenchmarkSemaphoreCycles = WakeupBenchmarkTotalCycles / WAKEUPBENCHMARK_NUM_WAKEUPS;
+
+    WakeupBenchmarkTotalCycles = 0;
+    ThreadHandle_t waiter =
+        OS_Thread_Create(WakeupBenchmark_NotifyWaiter, OS_SCHEDL_PRIO_MAX, "NotifyWaiter", OS_STACKSIZE_MIN);
+    for (uint32_t idx = 0; idx < WAKEUPBENCHMARK_NUM_WAKEUPS; idx++)
+    {
+        WakeupBenchmarkStartCycles = DWT->CYCCNT;
+        OS_Thread_NotifyGive(waiter);
+    }
+    WakeupBenchmarkNotifyCycles = WakeupBenchmarkTotalCycles / WAKEUPBENCHMARK_NUM_WAKEUPS;
+
+    /* The EXTI1 interrupt is pended by software, its handler signals the semaphore */
+    WakeupBenchmarkTotalCycles = 0;
+    HAL_NVIC_SetPriority(EXTI1_IRQn, OS_KERNEL_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+    OS_Thread_Create(WakeupBenchmark_SemaphoreWaiter, OS_SCHEDL_PRIO_MAX, "SemaphoreWaiter", OS_STACKSIZE_MIN);
+    for (uint32_t idx = 0; idx < WAKEUPBENCHMARK_NUM_WAKEUPS; idx++)
+    {
+        WakeupBenchmarkStartCycles = DWT->CYCCNT;
+        HAL_NVIC_SetPendingIRQ(EXTI1_IRQn);
+        __DSB();
+        __ISB();
+    }
+    HAL_NVIC_DisableIRQ(EXTI1_IRQn);
+    WakeupBenchmarkISRCycles = WakeupBenchmarkTotalCycles / WAKEUPBENCHMARK_NUM_WAKEUPS;
+    OS_Thread_Kill();
+}
+
+void UserTask_WakeupBenchmarkIRQHandler(void)
+{
+    OS_Semaphore_Signal(&WakeupBenchmarkSemaphore);
+}
+
+void UserTask_TimingWheelBenchmark(void)
+{
+    static Timeout_t timeouts[TIMINGWHEELBENCHMARK_MAX_ENTRIES];
+
+    /* The ticks are driven by calling the SysTick ISR from here, with the SysTick and the SchedlTimer
+     * interrupts off, so that nothing else runs meanwhile */
+    HAL_SuspendTick();
+    SchedlTimer_Stop();
+    for (uint32_t count_idx = 0; count_idx < TIMINGWHEELBENCHMARK_NUM_COUNTS; count_idx++)
+    {
+        uint32_t timeouts_count = TimingWheelBenchmarkCounts[count_idx];
+        for (uint32_t timeout_idx = 0; timeout_idx < timeouts_count; timeout_idx++)
+        {
+            OS_Timeout_Init(&(timeouts[timeout_idx]), TimingWheelBenchmark_Rearm, &(timeouts[timeout_idx]));
+            OS_Timeout_Start(&(timeouts[timeout_idx]), TimingWheelBenchmark_Random());
+        }
+
+        uint32_t total_cycles = 0;
+        uint32_t max_cycles = 0;
+        for (uint32_t tick_idx = 0; tick_idx < TIMINGWHEELBENCHMARK_NUM_TICKS; tick_idx++)
+        {
+            uint32_t start_cycles = DWT->CYCCNT;
+            SysTick_Handler();
+            uint32_t cycles = DWT->CYCCNT - start_cycles;
+            total_cycles += cycles;
+            if (cycles > max_cycles)
+            {
+                max_cycles = cycles;
+            }
+        }
+        TimingWheelBenchmarkAverageCycles[count_idx] = total_cycles / TIMINGWHEELBENCHMARK_NUM_TICKS;
+        TimingWheelBenchmarkMaxCycles[count_idx] = max_cycles;
+
+        for (uint32_t timeout_idx = 0; timeout_idx < timeouts_count; timeout_idx++)
+        {
+            OS_Timeout_Cancel(&(timeouts[timeout_idx]));
+        }
+    }
+    SchedlTimer_Start();
+    HAL_ResumeTick();
+    OS_Thread_Kill();
+}
+
+void UserTask_SchedulerBenchmark(void)
+{
+    uint32_t threads_count = 1;
+    for (uint32_t count_idx = 0; count_idx < SCHEDULERBENCHMARK_NUM_COUNTS; count_idx++)
+    {
+        uint32_t count = SchedulerBenchmarkCounts[count_idx];
+
+        /* The fillers are spread over the priority bitmap, below the benchmark, so that it stays the one to run */
+        if (count <= MAXNUMTHREADS)
+        {
+            while (threads_count < count)
+            {
+                uint8_t priority = (uint8_t)(OS_SCHEDL_PRIO_MAX + 2 + threads_count * 25);
+                OS_Thread_Create(SchedulerBenchmark_Filler, priority, "SchedulerBenchmark_Filler", OS_STACKSIZE_MIN);
+                threads_count++;
+            }
+            uint32_t total_cycles = 0;
+            for (uint32_t run_idx = 0; run_idx < SCHEDULERBENCHMARK_NUM_RUNS; run_idx++)
+            {
+                OS_Critical_Enter();
+                uint32_t start_cycles = DWT->CYCCNT;
+                OS_Scheduler();
+                total_cycles += DWT->CYCCNT - start_cycles;
+                OS_Critical_Exit();
+            }
+            SchedulerBenchmarkBitmapCycles[count_idx] = total_cycles / SCHEDULERBENCHMARK_NUM_RUNS;
+        }
+
+        /* Every third TCB sleeps and every fifth is blocked, the one to run is the last of the ring */
+        for (uint32_t tcb_idx = 0; tcb_idx < count; tcb_idx++)
+        {
+            SchedulerBenchmarkTCBs[tcb_idx] = (SchedulerBenchmarkTCB_t){
+                .next = &(SchedulerBenchmarkTCBs[(tcb_idx + 1) % count]),
+                .sleep = (tcb_idx % 3 == 1) ? 10 : 0,
+                .blocked = (tcb_idx % 5 == 2) ? &(SchedulerBenchmarkTCBs[0]) : NULL,
+                .priority = (uint8_t)(OS_SCHEDL_PRIO_MIN - tcb_idx),
+            };
+        }
+        uint32_t total_cycles = 0;
+        for (uint32_t run_idx = 0; run_idx < SCHEDULERBENCHMARK_NUM_RUNS; run_idx++)
+        {
+            OS_Critical_Enter();
+            uint32_t start_cycles = DWT->CYCCNT;
+            SchedulerBenchmarkBestPt = SchedulerBenchmark_LinearScan(&(SchedulerBenchmarkTCBs[0]));
+            total_cycles += DWT->CYCCNT - start_cycles;
+            OS_Critical_Exit();
+        }
+        SchedulerBenchmarkLinearCycles[count_idx] = total_cycles / SCHEDULERBENCHMARK_NUM_RUNS;
+    }
+    OS_Thread_Kill();
+}
+
+void UserTask_SleepTest(void)
+{
+    for (uint32_t duration_idx = 0; duration_idx < SLEEPTEST_NUM_DURATIONS; duration_idx++)
+    {
+        uint32_t duration_ms = SleepTestDurationsMs[duration_idx];
+        for (uint32_t round_idx = 0; round_idx < SLEEPTEST_NUM_ROUNDS; round_idx++)
+        {
+            /* The sleep starts anywhere within a tick, so it can last one tick less than asked in HAL ticks */
+            uint32_t start_tick = HAL_GetTick();
+            OS_Thread_Sleep(duration_ms);
+            uint32_t elapsed_ms = HAL_GetTick() - start_tick;
+            assert_or_panic(elapsed_ms + 1 >= duration_ms && elapsed_ms <= duration_ms + 1);
+            if (elapsed_ms > SleepTestMaxElapsedMs[duration_idx])
+            {
+                SleepTestMaxElapsedMs[duration_idx] = elapsed_ms;
+            }
+        }
+    }
+    OS_Thread_Kill();
+}
+
+void UserTask_ContextSwitchBenchmark(void)
+{
+    ContextSwitchBenchmarkCycles = ContextSwitchBenchmark_Run(false, false);
+    ContextSwitchBenchmarkFPCycles = ContextSwitchBenchmark_Run(true, false);
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    ContextSwitchBenchmarkDMACycles = ContextSwitchBenchmark_Run(false, true);
+    ContextSwitchBenchmarkDMAFPCycles = ContextSwitchBenchmark_Run(true, true);
+    __HAL_RCC_DMA1_CLK_DISABLE();
+    OS_Thread_Kill();
+}
+
+void UserTask_PriorityInversionTest(void)
+{
+    OS_Mutex_Init(&PriorityInversionTestMutexA);
+    OS_Mutex_Init(&PriorityInversionTestMutexB);
+    OS_Semaphore_Init(&PriorityInversionTestDone, 0);
+
+    /* Find how many iterations of busy work make up a critical section, nothing else runs meanwhile */
+    uint32_t start_cycles = DWT->CYCCNT;
+    PriorityInversionTest_Work(PRIORITYINVERSIONTEST_CALIBRATION_ITERATIONS);
+    uint32_t calibration_cycles = DWT->CYCCNT - start_cycles;
+    uint64_t target_cycles = (uint64_t)PRIORITYINVERSIONTEST_CS_MS * (SystemCoreClock / 1000);
+    PriorityInversionTestCSIterations =
+        (uint32_t)(target_cycles * PRIORITYINVERSIONTEST_CALIBRATION_ITERATIONS / calibration_cycles);
+    start_cycles = DWT->CYCCNT;
+    PriorityInversionTest_Work(PriorityInversionTestCSIterations);
+    PriorityInversionTestCSCycles = DWT->CYCCNT - start_cycles;
+    uint32_t margin_cycles = PriorityInversionTestCSCycles / 100 * PRIORITYINVERSIONTEST_MARGIN_PERCENT;
+
+    /* Low holds mutex A when High locks it: High waits for the rest of Low's critical section, not for Hog */
+    PriorityInversionTestLowMutex = &PriorityInversionTestMutexA;
+    OS_Thread_Create(PriorityInversionTest_High, OS_SCHEDL_PRIO_MAX + 2, "PriorityInversionTest_High",
+                     OS_STACKSIZE_MIN);
+    OS_Thread_Create(PriorityInversionTest_Hog, OS_SCHEDL_PRIO_MAX + 3, "PriorityInversionTest_Hog", OS_STACKSIZE_MIN);
+    OS_Thread_Create(PriorityInversionTest_Low, OS_SCHEDL_PRIO_MAX + 5, "PriorityInversionTest_Low", OS_STACKSIZE_MIN);
+    PriorityInversionTest_WaitWorkers(3);
+    PriorityInversionTestBlockingCycles = PriorityInversionTestHighBlockingCycles;
+    assert_or_panic(PriorityInversionTestBlockingCycles <= PriorityInversionTestCSCycles + margin_cycles);
+
+    /* Chain holds mutex A, blocked on mutex B held by Low, when High locks mutex A: the inheritance must be
+     * transitive, for High to wait for the rest of Low's critical section and Chain's, not for Hog */
+    PriorityInversionTestLowMutex = &PriorityInversionTestMutexB;
+    OS_Thread_Create(PriorityInversionTest_High, OS_SCHEDL_PRIO_MAX + 2, "PriorityInversionTest_High",
+                     OS_STACKSIZE_MIN);
+    OS_Thread_Create(PriorityInversionTest_Hog, OS_SCHEDL_PRIO_MAX + 3, "PriorityInversionTest_Hog", OS_STACKSIZE_MIN);
+    OS_Thread_Create(PriorityInversionTest_Chain, OS_SCHEDL_PRIO_MAX + 4, "PriorityInversionTest_Chain",
+                     OS_STACKSIZE_MIN);
+    OS_Thread_Create(PriorityInversionTest_Low, OS_SCHEDL_PRIO_MAX + 5, "PriorityInversionTest_Low", OS_STACKSIZE_MIN);
+    PriorityInversionTest_WaitWorkers(4);
+    PriorityInversionTestChainedBlockingCycles = PriorityInversionTestHighBlockingCycles;
+    assert_or_panic(PriorityInversionTestChainedBlockingCycles <= 2 * PriorityInversionTestCSCycles + margin_cycles);
+
+    OS_Thread_Kill();
+}
+
+void UserTask_InterruptLatencyBenchmark(void)
+{
+    /* TIM7 runs at the APB1 timer clock, which is twice PCLK1 unless APB1 isn't divided */
+    __HAL_RCC_TIM7_CLK_ENABLE();
+    uint32_t timer_clock_hz = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+    {
+        timer_clock_hz *= 2;
+    }
+    TIM7->PSC = 0;
+    TIM7->ARR = timer_clock_hz / INTERRUPTLATENCYBENCHMARK_FREQUENCY_HZ - 1;
+    TIM7->EGR = TIM_EGR_UG;
+    TIM7->SR = 0;
+    TIM7->DIER = TIM_DIER_UIE;
+
+    uint32_t cycles_per_tick = SystemCoreClock / timer_clock_hz;
+    InterruptLatencyBenchmarkZeroLatencyCycles =
+        InterruptLatencyBenchmark_Run(INTERRUPTLATENCYBENCHMARK_ZERO_LATENCY_PRIORITY) * cycles_per_tick;
+    InterruptLatencyBenchmarkMaskedCycles = InterruptLatencyBenchmark_Run(OS_KERNEL_IRQ_PRIORITY) * cycles_per_tick;
+    __HAL_RCC_TIM7_CLK_DISABLE();
+    OS_Thread_Kill();
+}
+
+void UserTask_InterruptLatencyBenchmarkIRQHandler(void)
+{
+    /* The counter restarted from 0 on the update event, it holds the ticks elapsed since */
+    uint32_t latency_ticks = TIM7->CNT;
+    TIM7->SR = ~TIM_SR_UIF;
+    if (latency_ticks > InterruptLatencyBenchmarkMaxTicks)
+    {
+        InterruptLatencyBenchmarkMaxTicks = latency_ticks;
+    }
+    InterruptLatencyBenchmarkCount++;
+}
+
 //==================================================================================================
 // STATIC FUNCTIONS
 //==================================================================================================
+
+static void WakeupBenchmark_SemaphoreWaiter(void)
+{
+    for (uint32_t idx = 0; idx < WAKEUPBENCHMARK_NUM_WAKEUPS; idx++)
+    {
+        OS_Semaphore_Wait(&WakeupBenchmarkSemaphore);
+        WakeupBenchmarkTotalCycles += DWT->CYCCNT - WakeupBenchmarkStartCycles;
+    }
+    OS_Thread_Kill();
+}
+
+static void WakeupBenchmark_NotifyWaiter(void)
+{
+    for (uint32_t idx = 0; idx < WAKEUPBENCHMARK_NUM_WAKEUPS; idx++)
+    {
+        OS_Thread_NotifyWait(UINT32_MAX);
+        WakeupBenchmarkTotalCycles += DWT->CYCCNT - WakeupBenchmarkStartCycles;
+    }
+    OS_Thread_Kill();
+}
+
+static uint32_t TimingWheelBenchmark_Random(void)
+{
+    /* Linear congruential generator from "Numerical Recipes" */
+    TimingWheelBenchmarkSeed = TimingWheelBenchmarkSeed * 1664525U + 1013904223U;
+    return (TimingWheelBenchmarkSeed >> 16) % TIMINGWHEELBENCHMARK_MAX_TICKS + 1;
+}
+
+static void SchedulerBenchmark_Filler(void)
+{
+    OS_Thread_Kill();
+}
+
+static SchedulerBenchmarkTCB_t *SchedulerBenchmark_LinearScan(SchedulerBenchmarkTCB_t *run_pt)
+{
+    SchedulerBenchmarkTCB_t *next_pt = run_pt->next;
+    SchedulerBenchmarkTCB_t *iterating_pt = next_pt;
+
+    uint32_t max_priority = UINT8_MAX + 1;
+    SchedulerBenchmarkTCB_t *best_pt = next_pt;
+    do
+    {
+        if ((iterating_pt->priority < max_priority) && (iterating_pt->sleep == 0) && (iterating_pt->blocked == NULL))
+        {
+            best_pt = iterating_pt;
+            max_priority = best_pt->priority;
+        }
+        iterating_pt = iterating_pt->next;
+    } while (iterating_pt != next_pt);
+    return best_pt;
+}
+
+static uint32_t ContextSwitchBenchmark_Run(bool use_fpu, bool use_dma)
+{
+    OS_Semaphore_Init(&ContextSwitchBenchmarkDone, 0);
+    ContextSwitchBenchmarkUseFPU = use_fpu;
+    ContextSwitchBenchmarkUseDMA = use_dma;
+    if (use_dma)
+    {
+        ContextSwitchBenchmark_ArmDMA();
+    }
+    ContextSwitchBenchmarkIsStarted = false;
+    ContextSwitchBenchmarkTotalCycles = 0;
+    ContextSwitchBenchmarkCount = 0;
+
+    /* The workers only run, round-robin, while the calling thread waits for them */
+    for (uint32_t worker_idx = 0; worker_idx < 2; worker_idx++)
+    {
+        OS_Thread_Create(ContextSwitchBenchmark_Worker, OS_SCHEDL_PRIO_MAX + 2, "ContextSwitchBenchmark_Worker",
+                         OS_STACKSIZE_MIN);
+    }
+    OS_Semaphore_Wait(&ContextSwitchBenchmarkDone);
+    OS_Semaphore_Wait(&ContextSwitchBenchmarkDone);
+    OS_Thread_Sleep(1); /* Let the last worker kill itself */
+    DMA1_Channel1->CCR = 0;
+    return ContextSwitchBenchmarkTotalCycles / ContextSwitchBenchmarkCount;
+}
+
+static void ContextSwitchBenchmark_Worker(void)
+{
+    /* The first worker to see the count reached exits, the other one exits as soon as it's scheduled again */
+    while (ContextSwitchBenchmarkCount < CONTEXTSWITCHBENCHMARK_NUM_SWITCHES)
+    {
+        if (ContextSwitchBenchmarkUseFPU)
+        {
+            ContextSwitchBenchmarkFloat *= 1.0001f;
+        }
+        /* Re-arm the DMA outside of the measurement, before it runs out */
+        if (ContextSwitchBenchmarkUseDMA && (DMA1_Channel1->CNDTR == 0))
+        {
+            ContextSwitchBenchmark_ArmDMA();
+        }
+        ContextSwitchBenchmarkStartCycles = DWT->CYCCNT;
+        ContextSwitchBenchmarkIsStarted = true;
+        OS_Thread_Suspend();
+        if (ContextSwitchBenchmarkIsStarted)
+        {
+            ContextSwitchBenchmarkTotalCycles += DWT->CYCCNT - ContextSwitchBenchmarkStartCycles;
+            ContextSwitchBenchmarkCount++;
+            ContextSwitchBenchmarkIsStarted = false;
+        }
+    }
+    OS_Semaphore_Signal(&ContextSwitchBenchmarkDone);
+    OS_Thread_Kill();
+}
+
+static void ContextSwitchBenchmark_ArmDMA(void)
+{
+    /* Word transfers between two fixed addresses, at the highest priority, with no interrupt */
+    DMA1_Channel1->CCR = 0;
+    DMA1_Channel1->CPAR = (uint32_t)&ContextSwitchBenchmarkDMASource;
+    DMA1_Channel1->CMAR = (uint32_t)&ContextSwitchBenchmarkDMADestination;
+    DMA1_Channel1->CNDTR = CONTEXTSWITCHBENCHMARK_DMA_WORDS;
+    DMA1_Channel1->CCR = DMA_CCR_MEM2MEM | DMA_CCR_PL | DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1 | DMA_CCR_EN;
+}
+
+static void PriorityInversionTest_Work(uint32_t iterations)
+{
+    for (volatile uint32_t iteration_idx = 0; iteration_idx < iterations; iteration_idx++)
+    {
+    }
+}
+
+static void PriorityInversionTest_WaitWorkers(uint32_t count)
+{
+    for (uint32_t worker_idx = 0; worker_idx < count; worker_idx++)
+    {
+        OS_Semaphore_Wait(&PriorityInversionTestDone);
+    }
+    OS_Thread_Sleep(1);
+}
+
+static void PriorityInversionTest_High(void)
+{
+    OS_Thread_Sleep(3);
+    uint32_t start_cycles = DWT->CYCCNT;
+    OS_Mutex_Lock(&PriorityInversionTestMutexA);
+    PriorityInversionTestHighBlockingCycles = DWT->CYCCNT - start_cycles;
+    OS_Mutex_Unlock(&PriorityInversionTestMutexA);
+    OS_Semaphore_Signal(&PriorityInversionTestDone);
+    OS_Thread_Kill();
+}
+
+static void PriorityInversionTest_Hog(void)
+{
+    OS_Thread_Sleep(2);
+    PriorityInversionTest_Work(PRIORITYINVERSIONTEST_HOG_FACTOR * PriorityInversionTestCSIterations);
+    OS_Semaphore_Signal(&PriorityInversionTestDone);
+    OS_Thread_Kill();
+}
+
+static void PriorityInversionTest_Chain(void)
+{
+    OS_Thread_Sleep(1);
+    OS_Mutex_Lock(&PriorityInversionTestMutexA);
+    OS_Mutex_Lock(&PriorityInversionTestMutexB);
+    PriorityInversionTest_Work(PriorityInversionTestCSIterations);
+    OS_Mutex_Unlock(&PriorityInversionTestMutexB);
+    OS_Mutex_Unlock(&PriorityInversionTestMutexA);
+    OS_Semaphore_Signal(&PriorityInversionTestDone);
+    OS_Thread_Kill();
+}
+
+static void PriorityInversionTest_Low(void)
+{
+    OS_Mutex_Lock(PriorityInversionTestLowMutex);
+    PriorityInversionTest_Work(PriorityInversionTestCSIterations);
+    OS_Mutex_Unlock(PriorityInversionTestLowMutex);
+    OS_Semaphore_Signal(&PriorityInversionTestDone);
+    OS_Thread_Kill();
+}
+
+static uint32_t InterruptLatencyBenchmark_Run(uint32_t irq_priority)
+{
+    OS_Semaphore_Init(&InterruptLatencyBenchmarkPing, 0);
+    OS_Semaphore_Init(&InterruptLatencyBenchmarkPong, 0);
+    OS_Semaphore_Init(&InterruptLatencyBenchmarkDone, 0);
+    InterruptLatencyBenchmarkIsStopping = false;
+    InterruptLatencyBenchmarkMaxTicks = 0;
+    InterruptLatencyBenchmarkCount = 0;
+
+    HAL_NVIC_SetPriority(TIM7_IRQn, irq_priority, 0);
+    HAL_NVIC_EnableIRQ(TIM7_IRQn);
+    TIM7->CNT = 0;
+    TIM7->CR1 = TIM_CR1_CEN;
+
+    /* The ping and pong threads only run while the calling thread sleeps */
+    OS_Thread_Create(InterruptLatencyBenchmark_Ping, OS_SCHEDL_PRIO_MAX + 2, "InterruptLatencyBenchmark_Ping",
+                     OS_STACKSIZE_MIN);
+    OS_Thread_Create(InterruptLatencyBenchmark_Pong, OS_SCHEDL_PRIO_MAX + 2, "InterruptLatencyBenchmark_Pong",
+                     OS_STACKSIZE_MIN);
+    OS_Thread_Sleep(INTERRUPTLATENCYBENCHMARK_DURATION_MS);
+    InterruptLatencyBenchmarkIsStopping = true;
+    OS_Semaphore_Wait(&InterruptLatencyBenchmarkDone);
+    OS_Semaphore_Wait(&InterruptLatencyBenchmarkDone);
+    OS_Thread_Sleep(1); /* Let the last thread kill itself */
+
+    TIM7->CR1 = 0;
+    HAL_NVIC_DisableIRQ(TIM7_IRQn);
+    assert_or_panic(InterruptLatencyBenchmarkCount > 0);
+    return InterruptLatencyBenchmarkMaxTicks;
+}
+
+static void InterruptLatencyBenchmark_Ping(void)
+{
+    while (!InterruptLatencyBenchmarkIsStopping)
+    {
+        OS_Semaphore_Signal(&InterruptLatencyBenchmarkPong);
+        OS_Semaphore_Wait(&InterruptLatencyBenchmarkPing);
+    }
+    /* Pong may be blocked, waiting for its turn */
+    OS_Semaphore_Signal(&InterruptLatencyBenchmarkPong);
+    OS_Semaphore_Signal(&InterruptLatencyBenchmarkDone);
+    OS_Thread_Kill();
+}
+
+static void InterruptLatencyBenchmark_Pong(void)
+{
+    while (true)
+    {
+        OS_Semaphore_Wait(&InterruptLatencyBenchmarkPong);
+        if (InterruptLatencyBenchmarkIsStopping)
+        {
+            break;
+        }
+        OS_Semaphore_Signal(&InterruptLatencyBenchmarkPing);
+    }
+    /* Ping may be blocked, waiting for its turn */
+    OS_Semaphore_Signal(&InterruptLatencyBenchmarkPing);
+    OS_Semaphore_Signal(&InterruptLatencyBenchmarkDone);
+    OS_Thread_Kill();
+}
+
+static void TimingWheelBenchmark_Rearm(void *arg)
+{
+    OS_Timeout_Start(arg, TimingWheelBenchmark_Random());
+}